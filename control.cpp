@@ -0,0 +1,266 @@
+#include "shell.h"
+
+using namespace std;
+
+/* Control socket, aktif dengan "set -o control".
+   Satu request per baris, satu response JSON per baris:
+     jobs                 daftar job
+     signal %job SIGNAL   kirim signal ke process group job
+     resume %job          lanjutkan job yang di-stop di background
+     wait %job            response dikirim setelah job selesai
+   Semua fd non-blocking dan dilayani dari serviceEvents.  */
+
+static const unsigned int MAX_REQUEST = 4096;
+
+/* Tanpa $XDG_RUNTIME_DIR, socket ditaruh di /tmp/shell-<uid> milik user sendiri
+   dengan mode 0700. Direktori yang sudah ada tapi bukan milik kita ditolak.  */
+static bool privateRuntimeDir(string& dir) {
+    stringstream ss;
+    ss << "/tmp/shell-" << getuid();
+    dir = ss.str();
+    if (mkdir(dir.c_str(), 0700) < 0 && errno != EEXIST) {
+        cerr << "control: " << dir << ": " << strerror(errno) << endl;
+        return false;
+    }
+    struct stat st;
+    if (lstat(dir.c_str(), &st) < 0) {
+        cerr << "control: " << dir << ": " << strerror(errno) << endl;
+        return false;
+    }
+    if (!S_ISDIR(st.st_mode) || st.st_uid != getuid() || (st.st_mode & 077)) {
+        cerr << "control: " << dir << ": not a private directory" << endl;
+        return false;
+    }
+    return true;
+}
+
+bool Shell::openControlSocket() {
+    const char* path = getenv("SHELL_CONTROL_SOCKET");
+    if (path && *path)
+        controlPath = path;
+    else {
+        const char* runtime = getenv("XDG_RUNTIME_DIR");
+        string dir;
+        if (runtime && *runtime)
+            dir = runtime;
+        else if (!privateRuntimeDir(dir))
+            return false;
+        stringstream ss;
+        ss << dir << "/shell-" << getpid() << ".sock";
+        controlPath = ss.str();
+    }
+
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (controlPath.size() >= sizeof(address.sun_path)) {
+        cerr << "control: " << controlPath << ": path too long" << endl;
+        return false;
+    }
+    strcpy(address.sun_path, controlPath.c_str());
+
+    // socket basi dari shell sebelumnya boleh dihapus, file lain jangan
+    struct stat st;
+    if (lstat(controlPath.c_str(), &st) == 0) {
+        if (!S_ISSOCK(st.st_mode)) {
+            cerr << "control: " << controlPath << ": file exists" << endl;
+            return false;
+        }
+        unlink(controlPath.c_str());
+    }
+
+    controlSocket = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (controlSocket < 0) {
+        cerr << "control: " << strerror(errno) << endl;
+        return false;
+    }
+    mode_t oldMask = umask(0077);
+    bool bound = bind(controlSocket, (struct sockaddr*) &address, sizeof(address)) == 0;
+    umask(oldMask);
+    if (!bound || listen(controlSocket, SOMAXCONN) < 0) {
+        cerr << "control: " << controlPath << ": " << strerror(errno) << endl;
+        close(controlSocket);
+        controlSocket = -1;
+        return false;
+    }
+    cout << "control: listening on " << controlPath << endl;
+    return true;
+}
+
+void Shell::closeControlSocket() {
+    if (controlSocket == -1)
+        return;
+    for (unsigned int i = 0; i < controlClients.size(); ++i)
+        close(controlClients[i].fd);
+    controlClients.clear();
+    close(controlSocket);
+    unlink(controlPath.c_str());
+    controlSocket = -1;
+}
+
+void Shell::addControlEvents(vector<struct pollfd>& fds) {
+    if (controlSocket == -1)
+        return;
+    struct pollfd fd;
+    fd.fd = controlSocket;
+    fd.events = POLLIN;
+    fds.push_back(fd);
+    for (unsigned int i = 0; i < controlClients.size(); ++i) {
+        fd.fd = controlClients[i].fd;
+        fd.events = (controlClients[i].closing ? 0 : POLLIN) | (controlClients[i].output.size() ? POLLOUT : 0);
+        fds.push_back(fd);
+    }
+}
+
+void Shell::handleControlEvents(const vector<struct pollfd>& fds, unsigned int index) {
+    if (controlSocket == -1 || index >= fds.size())
+        return;
+
+    // Client lama dulu, index di fds sesuai urutan controlClients sebelum accept
+    unsigned int nClients = controlClients.size();
+    for (unsigned int i = 0; i < nClients; ++i) {
+        ControlClient& client = controlClients[i];
+        short revents = fds[index+1+i].revents;
+        if (revents & POLLIN) {
+            char buffer[4096];
+            ssize_t n;
+            while ((n = read(client.fd, buffer, sizeof(buffer))) > 0)
+                client.input.append(buffer, n);
+
+            size_t newline;
+            while ((newline = client.input.find('\n')) != string::npos) {
+                string request = client.input.substr(0, newline);
+                client.input.erase(0, newline+1);
+                if (request.size() && request[request.size()-1] == '\r')
+                    request.erase(request.size()-1);
+                handleControlRequest(client, request);
+            }
+            if (n == 0 || client.input.size() > MAX_REQUEST)
+                client.closing = true;
+        }
+        if (revents & (POLLHUP | POLLERR)) {
+            client.closing = true;
+            client.waitPid = 0;
+            client.output.clear();
+        }
+        if (client.output.size() && !flushControlClient(client))
+            client.closing = true;
+    }
+
+    closeFinishedClients();
+
+    if (fds[index].revents & POLLIN) {
+        int fd;
+        while ((fd = accept4(controlSocket, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+            ControlClient client;
+            client.fd = fd;
+            client.waitPid = 0;
+            client.waitId = 0;
+            client.closing = false;
+            controlClients.push_back(client);
+        }
+    }
+}
+
+void Shell::handleControlRequest(ControlClient& client, const string& request) {
+    vector<string> vRequest = parseCommand(request);
+    if (vRequest.empty())
+        return;
+
+    if (vRequest[0] == "jobs") {
+        stringstream ss;
+        jobManager.PrintJSON(ss);
+        client.output += ss.str();
+        return;
+    }
+
+    Job job;
+    bool byJobId = vRequest.size() > 1 && vRequest[1][0] == '%';
+    int value = -1;
+    if (vRequest.size() > 1) {
+        stringstream ss(byJobId ? vRequest[1].substr(1) : vRequest[1]);
+        ss >> value;
+    }
+    bool gotJob = byJobId ? jobManager.Get(job, value-1) : jobManager.Get(value, job);
+
+    if (vRequest[0] != "signal" && vRequest[0] != "resume" && vRequest[0] != "wait")
+        client.output += "{\"ok\":false,\"error\":\"unknown request\"}\n";
+    else if (vRequest.size() < 2 || (vRequest[0] == "signal" && vRequest.size() != 3))
+        client.output += "{\"ok\":false,\"error\":\"usage: " + vRequest[0] + (vRequest[0] == "signal" ? " %job signal" : " %job") + "\"}\n";
+    else if (!gotJob)
+        client.output += "{\"ok\":false,\"error\":\"no such job\"}\n";
+    else if (vRequest[0] == "signal") {
+        int sig = parseSignal(vRequest[2]);
+        if (sig < 0)
+            client.output += "{\"ok\":false,\"error\":\"invalid signal\"}\n";
+        else if (kill(job.Target(), sig) < 0)
+            client.output += string("{\"ok\":false,\"error\":\"") + strerror(errno) + "\"}\n";
+        else
+            client.output += "{\"ok\":true}\n";
+    }
+    else if (vRequest[0] == "resume") {
+        if (job.status == JobForeground)
+            client.output += "{\"ok\":false,\"error\":\"job is in the foreground\"}\n";
+        else if (kill(job.Target(), SIGCONT) < 0)
+            client.output += string("{\"ok\":false,\"error\":\"") + strerror(errno) + "\"}\n";
+        else {
+            jobManager.Change(job.pid, JobBackground);
+            client.output += "{\"ok\":true}\n";
+        }
+    }
+    else {
+        // Satu client hanya bisa menunggu satu job
+        if (client.waitPid)
+            client.output += "{\"ok\":false,\"error\":\"already waiting\"}\n";
+        else {
+            client.waitPid = job.pid;
+            client.waitId = job.id;
+        }
+    }
+}
+
+bool Shell::flushControlClient(ControlClient& client) {
+    while (client.output.size()) {
+        ssize_t n = send(client.fd, client.output.data(), client.output.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+            return true;
+        if (n < 0) {
+            client.output.clear();
+            client.waitPid = 0;
+            return false;
+        }
+        client.output.erase(0, n);
+    }
+    return true;
+}
+
+/* Job yang ditunggu client sudah hilang dari job list berarti sudah selesai.  */
+void Shell::checkControlWaiters() {
+    for (unsigned int i = 0; i < controlClients.size(); ++i) {
+        ControlClient& client = controlClients[i];
+        Job job;
+        if (!client.waitPid || jobManager.Get(client.waitPid, job))
+            continue;
+        stringstream ss;
+        ss << "{\"ok\":true,\"id\":" << client.waitId+1 << ",\"pid\":" << client.waitPid << ",\"done\":true}\n";
+        client.output += ss.str();
+        client.waitPid = 0;
+        if (!flushControlClient(client))
+            client.closing = true;
+    }
+    // Client yang sudah EOF tidak di-poll lagi, jadi tutup di sini setelah dijawab
+    closeFinishedClients();
+}
+
+/* Tutup client yang sudah selesai dan tidak menunggu job.  */
+void Shell::closeFinishedClients() {
+    for (unsigned int i = 0; i < controlClients.size(); ) {
+        ControlClient& client = controlClients[i];
+        if (client.closing && client.output.empty() && !client.waitPid) {
+            close(client.fd);
+            controlClients.erase(controlClients.begin()+i);
+        }
+        else
+            ++i;
+    }
+}
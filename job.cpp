@@ -1,7 +1,99 @@
 #include "job.h"
 
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <cerrno>
+#include <cstring>
+#include <algorithm>
+
 using namespace std;
 
+static string formatLimit(rlim_t value, const char* unit) {
+    if (value == RLIM_INFINITY)
+        return "unlimited";
+    stringstream ss;
+    ss << value << unit;
+    return ss.str();
+}
+
+/* Pemakaian CPU (detik) dan memory (KiB) sebuah job.
+   Kalau job punya cgroup, angka dari cgroup dipakai supaya anak-anaknya ikut terhitung.  */
+static bool readUsage(const Job& job, double& cpuSeconds, long& memoryKB) {
+    if (job.options.cgroup.size()) {
+        ifstream cpuStat((job.options.cgroup + "/cpu.stat").c_str());
+        ifstream memoryCurrent((job.options.cgroup + "/memory.current").c_str());
+        string key;
+        long long usec = -1, bytes = -1;
+        while (cpuStat >> key >> usec && key != "usage_usec");
+        memoryCurrent >> bytes;
+        if (usec >= 0 && bytes >= 0) {
+            cpuSeconds = usec / 1e6;
+            memoryKB = bytes / 1024;
+            return true;
+        }
+    }
+
+    stringstream path;
+    path << "/proc/" << job.pid << "/stat";
+    ifstream stat(path.str().c_str());
+    string line;
+    if (!getline(stat, line))
+        return false;
+    // Field setelah ")" mulai dari field ke-3 (state)
+    size_t close = line.rfind(')');
+    if (close == string::npos)
+        return false;
+    stringstream fields(line.substr(close+2));
+    string field;
+    unsigned long long utime = 0, stime = 0;
+    long rss = 0;
+    for (int i = 3; fields >> field; ++i) {
+        if (i == 14)
+            utime = strtoull(field.c_str(), NULL, 10);
+        else if (i == 15)
+            stime = strtoull(field.c_str(), NULL, 10);
+        else if (i == 24) {
+            rss = strtol(field.c_str(), NULL, 10);
+            break;
+        }
+    }
+    cpuSeconds = (double) (utime + stime) / sysconf(_SC_CLK_TCK);
+    memoryKB = rss * (sysconf(_SC_PAGESIZE) / 1024);
+    return true;
+}
+
+static const char* statusName(int status) {
+    switch (status) {
+    case JobForeground:
+        return "foreground";
+    case JobBackground:
+        return "background";
+    case JobSuspended:
+        return "suspended";
+    case JobWaitingInput:
+        return "waiting_input";
+    }
+    return "unknown";
+}
+
+static void printJSONString(ostream& out, const string& str) {
+    out << '"';
+    for (unsigned int i = 0; i < str.size(); ++i) {
+        unsigned char c = str[i];
+        if (c == '"' || c == '\\')
+            out << '\\' << c;
+        else if (c < 0x20) {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out << escaped;
+        }
+        else
+            out << c;
+    }
+    out << '"';
+}
+
 JobManager::JobManager() {
 
 }
@@ -10,7 +102,7 @@ JobManager::~JobManager() {
 
 }
 
-Job JobManager::Insert(pid_t pid, pid_t pgid, string& name, JobStatus status) {
+Job JobManager::Insert(pid_t pid, pid_t pgid, string& name, JobStatus status, const JobOptions& options) {
     Job newJob;
 
     newJob.id = jobsList.size();
@@ -18,6 +110,10 @@ Job JobManager::Insert(pid_t pid, pid_t pgid, string& name, JobStatus status) {
     newJob.pid = pid;
     newJob.pgid = pgid;
     newJob.status = status;
+    newJob.options = options;
+    clock_gettime(CLOCK_MONOTONIC, &newJob.started);
+    newJob.outputFd = -1;
+    newJob.expiredSignal = 0;
 
     jobsList.push_back(newJob);
     return newJob;
@@ -33,9 +129,64 @@ bool JobManager::Change(pid_t pid, JobStatus status) {
     return false;
 }
 
+bool JobManager::Change(pid_t pid, const JobOptions& options) {
+    for (unsigned int i = 0; i < jobsList.size(); ++i) {
+        if (jobsList[i].pid == pid) {
+            jobsList[i].options = options;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool JobManager::MarkExpired(pid_t pid, int sig) {
+    for (unsigned int i = 0; i < jobsList.size(); ++i) {
+        if (jobsList[i].pid == pid) {
+            jobsList[i].expiredSignal = sig;
+            return true;
+        }
+    }
+    return false;
+}
+
+static double elapsedSince(const struct timespec& started) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - started.tv_sec) + (now.tv_nsec - started.tv_nsec) / 1e9;
+}
+
 void JobManager::Delete(Job& job) {
     for (unsigned int i = 0; i < jobsList.size(); ++i) {
         if (jobsList[i].pid == job.pid) {
+            if (jobsList[i].options.cgroup.size())
+                rmdir(jobsList[i].options.cgroup.c_str());
+            if (jobsList[i].outputFd != -1) {
+                // Sisa output terakhir masih dibaca, job foreground langsung ke terminal
+                readOutput(jobsList[i], true);
+                close(jobsList[i].outputFd);
+            }
+            // Output yang belum dilihat tetap disimpan setelah job selesai, yang paling lama dibuang
+            map<pid_t, OutputBuffer>::iterator output = outputs.find(jobsList[i].pid);
+            if (output != outputs.end() && output->second.Size()) {
+                FinishedOutput finished;
+                finished.id = jobsList[i].id;
+                finished.name = jobsList[i].name;
+                finished.output = output->second;
+                finishedOutputs.push_back(finished);
+                if (finishedOutputs.size() > MAX_FINISHED_OUTPUTS)
+                    finishedOutputs.erase(finishedOutputs.begin());
+            }
+            if (output != outputs.end())
+                outputs.erase(output);
+            // Job yang dihentikan timeout tetap dilaporkan di jobs berikutnya
+            if (jobsList[i].expiredSignal) {
+                ExpiredJob expired;
+                expired.id = jobsList[i].id;
+                expired.name = jobsList[i].name;
+                expired.runtime = elapsedSince(jobsList[i].started);
+                expired.signal = jobsList[i].expiredSignal;
+                expiredList.push_back(expired);
+            }
             jobsList.erase(jobsList.begin() + i);
             return;
         }
@@ -69,6 +220,10 @@ bool JobManager::Get(JobStatus searchValue, Job& job) {
     return false;
 }
 
+void JobManager::GetAll(vector<Job>& jobs) {
+    jobs = jobsList;
+}
+
 bool JobManager::GetLastJob(Job& job) {
     if (jobsList.size()) {
         job = jobsList[jobsList.size()-1];
@@ -100,8 +255,213 @@ void JobManager::Print()
             << "[" << jobsList[i].id+1 << "] " \
             << jobsList[i].pid << ", " \
             << jobsList[i].name << ", " \
-            << status \
-            << endl;
+            << status;
+
+            const JobOptions& options = jobsList[i].options;
+            double cpuSeconds;
+            long memoryKB;
+            if (readUsage(jobsList[i], cpuSeconds, memoryKB))
+                cout << ", cpu " << cpuSeconds << "s, mem " << memoryKB << "K";
+            if (options.HasLimits()) {
+                cout \
+                << " (limit cpu " << formatLimit(options.cpu, "s") \
+                << ", mem " << formatLimit(options.memory == RLIM_INFINITY ? RLIM_INFINITY : options.memory/1024, "K") \
+                << ", files " << formatLimit(options.files, "");
+                if (options.hasCore)
+                    cout << ", core " << formatLimit(options.core == RLIM_INFINITY ? RLIM_INFINITY : options.core/1024, "K");
+                if (options.cpuQuota)
+                    cout << ", quota " << options.cpuQuota << "%";
+                if (options.cgroup.size())
+                    cout << ", cgroup " << options.cgroup;
+                cout << ")";
+            }
+            if (options.affinity.size()) {
+                cout << ", cpus ";
+                for (unsigned int j = 0; j < options.affinity.size(); ++j)
+                    cout << (j ? "," : "") << options.affinity[j];
+            }
+            if (options.hasNiceness)
+                cout << ", nice " << options.niceness;
+            if (options.ioClass != -1)
+                cout << ", ionice " << options.ioClass << ":" << options.ioLevel;
+            if (jobsList[i].expiredSignal)
+                cout << ", timed out (" << strsignal(jobsList[i].expiredSignal) << ")";
+            cout << endl;
             //printf("|  %7d | %30s | %5d | %10s | %6c |\n", jobsList[i].id, jobsList[i].name, jobsList[i].pid, jobsList[i].descriptor, jobsList[i].status);
         }
+
+        // Job yang selesai karena timeout, dilaporkan sekali saja
+        for (unsigned int i = 0; i < expiredList.size(); ++i) {
+            cout \
+            << "[" << expiredList[i].id+1 << "] " \
+            << expiredList[i].name << ", " \
+            << "Expired after " << expiredList[i].runtime << "s (" \
+            << strsignal(expiredList[i].signal) << ")" \
+            << endl;
+        }
+        expiredList.clear();
+
+        // Job selesai yang output-nya belum dilihat
+        for (unsigned int i = 0; i < finishedOutputs.size(); ++i) {
+            cout \
+            << "[" << finishedOutputs[i].id+1 << "] " \
+            << finishedOutputs[i].name << ", " \
+            << "Done, " << finishedOutputs[i].output.Size() << " bytes of output (jobs -o %" \
+            << finishedOutputs[i].id+1 << ")" \
+            << endl;
+        }
+}
+
+/* Satu object JSON per baris, dipakai control socket.  */
+void JobManager::PrintJSON(ostream& out) {
+    out << "{\"ok\":true,\"jobs\":[";
+    for (unsigned int i = 0; i < jobsList.size(); ++i) {
+        const Job& job = jobsList[i];
+        double runtime = elapsedSince(job.started);
+        double cpuSeconds = 0;
+        long memoryKB = 0;
+        bool hasUsage = readUsage(job, cpuSeconds, memoryKB);
+
+        out \
+        << (i ? "," : "") \
+        << "{\"id\":" << job.id+1 \
+        << ",\"pid\":" << job.pid \
+        << ",\"pgid\":" << job.pgid \
+        << ",\"name\":";
+        printJSONString(out, job.name);
+        out \
+        << ",\"state\":\"" << statusName(job.status) << "\"" \
+        << ",\"runtime\":" << runtime \
+        << ",\"timed_out\":" << (job.expiredSignal ? "true" : "false");
+        if (hasUsage)
+            out << ",\"cpu\":" << cpuSeconds << ",\"rss_kb\":" << memoryKB;
+        out << "}";
+    }
+    out << "]}\n";
+}
+
+OutputBuffer::OutputBuffer(size_t capacity):
+    capacity(capacity), start(0), size(0) {
+
+}
+
+void OutputBuffer::Write(const char* buffer, size_t length) {
+    if (data.empty())
+        data.resize(capacity);
+    // Hanya bagian terakhir yang muat yang disimpan
+    if (length > capacity) {
+        buffer += length - capacity;
+        length = capacity;
+    }
+    size_t end = (start + size) % capacity;
+    size_t first = min(length, capacity - end);
+    memcpy(&data[end], buffer, first);
+    memcpy(&data[0], buffer + first, length - first);
+
+    size += length;
+    if (size > capacity) {
+        start = (start + size - capacity) % capacity;
+        size = capacity;
+    }
+}
+
+void OutputBuffer::Print(ostream& out) const {
+    size_t first = min(size, capacity - start);
+    out.write(data.empty() ? NULL : &data[start], first);
+    out.write(data.empty() ? NULL : &data[0], size - first);
+}
+
+void OutputBuffer::Clear() {
+    start = size = 0;
+}
+
+void JobManager::AttachOutput(pid_t pid, int fd) {
+    for (unsigned int i = 0; i < jobsList.size(); ++i)
+        if (jobsList[i].pid == pid) {
+            jobsList[i].outputFd = fd;
+            outputs[pid];
+            return;
+        }
+    close(fd);
+}
+
+void JobManager::AddOutputEvents(vector<struct pollfd>& fds) {
+    struct pollfd fd;
+    fd.events = POLLIN;
+    for (unsigned int i = 0; i < jobsList.size(); ++i)
+        if (jobsList[i].outputFd != -1) {
+            fd.fd = jobsList[i].outputFd;
+            fds.push_back(fd);
+        }
+}
+
+/* fd dicocokkan ulang dengan job list, job bisa saja sudah dihapus SIGCHLD handler.  */
+void JobManager::HandleOutputEvents(const vector<struct pollfd>& fds, unsigned int index) {
+    for (; index < fds.size(); ++index) {
+        if (!fds[index].revents)
+            continue;
+        for (unsigned int i = 0; i < jobsList.size(); ++i)
+            if (jobsList[i].outputFd == fds[index].fd) {
+                readOutput(jobsList[i], false);
+                break;
+            }
+    }
+}
+
+/* Baca pipe output job (non-blocking). Job foreground langsung ditulis ke stdout,
+   selain itu masuk ring buffer.  */
+void JobManager::readOutput(Job& job, bool untilEmpty) {
+    char buffer[65536];
+    ssize_t n;
+    do {
+        n = read(job.outputFd, buffer, sizeof(buffer));
+        if (n > 0) {
+            if (job.status == JobForeground)
+                write(STDOUT_FILENO, buffer, n);
+            else
+                outputs[job.pid].Write(buffer, n);
+        }
+    } while ((n > 0 && untilEmpty) || (n < 0 && errno == EINTR));
+
+    if (n == 0 && !untilEmpty) {
+        close(job.outputFd);
+        job.outputFd = -1;
+    }
+}
+
+bool JobManager::PrintOutput(Job& job, ostream& out, bool clear) {
+    map<pid_t, OutputBuffer>::iterator output = outputs.find(job.pid);
+    if (output == outputs.end())
+        return false;
+    output->second.Print(out);
+    if (clear)
+        output->second.Clear();
+    return true;
+}
+
+/* Output job yang sudah selesai, yang paling lama dulu kalau id-nya sudah dipakai ulang.
+   Setelah ditampilkan output dibuang.  */
+bool JobManager::PrintFinishedOutput(int id, ostream& out) {
+    for (unsigned int i = 0; i < finishedOutputs.size(); ++i)
+        if (finishedOutputs[i].id == id) {
+            finishedOutputs[i].output.Print(out);
+            finishedOutputs.erase(finishedOutputs.begin() + i);
+            return true;
+        }
+    return false;
+}
+
+void JobManager::ClearFinishedOutputs() {
+    finishedOutputs.clear();
+}
+
+/* Dipakai subshell hasil fork supaya tidak ikut membaca output job shell induk.  */
+void JobManager::CloseOutputs() {
+    for (unsigned int i = 0; i < jobsList.size(); ++i)
+        if (jobsList[i].outputFd != -1) {
+            close(jobsList[i].outputFd);
+            jobsList[i].outputFd = -1;
+        }
+    outputs.clear();
+    finishedOutputs.clear();
 }
@@ -2,20 +2,92 @@
 #define JOB_H
 
 #include <vector>
+#include <map>
 
 #include <iostream>
 #include <cstdio>
 
 #include <unistd.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/resource.h>
+#include <poll.h>
 
 using namespace std;
 
+/* Limit dan penjadwalan yang dipasang di child sebelum exec.
+   memory dan cpuQuota dipasang lewat cgroup v2 kalau cgroup tidak kosong,
+   kalau tidak memory jatuh ke RLIMIT_AS.  */
+struct JobOptions {
+    rlim_t cpu;     // detik, RLIMIT_CPU
+    rlim_t memory;  // byte
+    rlim_t files;   // RLIMIT_NOFILE
+    rlim_t core;    // byte, RLIMIT_CORE
+    int cpuQuota;   // persen dari satu core, 0 = tidak dibatasi
+    bool hasCpu, hasMemory, hasFiles, hasCore;  // limit yang diberikan, termasuk unlimited
+    string cgroup;
+
+    vector<int> affinity;  // kosong = ikut shell
+    bool hasNiceness;
+    int niceness;
+    int ioClass;    // -1 = ikut shell
+    int ioLevel;
+
+    long long timeout;    // milidetik, 0 = tanpa batas
+    int timeoutSignal;
+    long long killAfter;  // masa tenggang sebelum SIGKILL, 0 = tidak ada
+
+    JobOptions(): cpu(RLIM_INFINITY), memory(RLIM_INFINITY), files(RLIM_INFINITY), core(RLIM_INFINITY), cpuQuota(0),
+        hasCpu(false), hasMemory(false), hasFiles(false), hasCore(false),
+        hasNiceness(false), niceness(0), ioClass(-1), ioLevel(4),
+        timeout(0), timeoutSignal(SIGTERM), killAfter(5000) {}
+    bool HasLimits() const {
+        return hasCpu || hasMemory || hasFiles || hasCore || cpuQuota;
+    }
+};
+
 struct Job {
     int id;
     string name;
     pid_t pid;
-    pid_t pgid;
+    pid_t pgid;     // 0 kalau shell tidak interaktif, job ikut process group shell
     int status;
+    JobOptions options;
+    struct timespec started;
+    int outputFd;   // pipe stdout/stderr job background, -1 kalau tidak ditangkap
+    int expiredSignal;  // signal dari timeout, 0 kalau belum lewat deadline
+
+    // Tujuan kill(): seluruh process group, atau pid saja kalau tanpa job control
+    pid_t Target() const { return pgid ? -pgid : pid; }
+};
+
+struct ExpiredJob {
+    int id;
+    string name;
+    double runtime;
+    int signal;
+};
+
+/* Ring buffer berukuran tetap, isi lama ditimpa kalau penuh.  */
+class OutputBuffer {
+private:
+    vector<char> data;
+    size_t capacity, start, size;
+
+public:
+    OutputBuffer(size_t = 65536);
+
+    void Write(const char*, size_t);
+    void Print(ostream&) const;
+    void Clear();
+    size_t Size() const { return size; };
+};
+
+/* Output job capture yang sudah selesai, disimpan sampai ditampilkan jobs -o atau fg.  */
+struct FinishedOutput {
+    int id;
+    string name;
+    OutputBuffer output;
 };
 
 enum JobStatus {
@@ -29,6 +101,11 @@ class JobManager {
 private:
     vector<Job> jobsList;
     int nActiveJobs;
+    map<pid_t, OutputBuffer> outputs;
+    vector<ExpiredJob> expiredList;
+    vector<FinishedOutput> finishedOutputs;
+    static const unsigned int MAX_FINISHED_OUTPUTS = 16;
+    void readOutput(Job&, bool);
 
 public:
     JobManager();
@@ -38,10 +115,22 @@ public:
     bool Get(pid_t, Job&);
     bool Get(Job&, int);
     bool GetLastJob(Job&);
-    Job Insert(pid_t, pid_t, string&, JobStatus);
+    void GetAll(vector<Job>&);
+    Job Insert(pid_t, pid_t, string&, JobStatus, const JobOptions& = JobOptions());
     bool Change(pid_t, JobStatus);
+    bool Change(pid_t, const JobOptions&);
+    bool MarkExpired(pid_t, int);
     void Delete(Job&);
     void Print();
+    void PrintJSON(ostream&);
+
+    void AttachOutput(pid_t, int);
+    void AddOutputEvents(vector<struct pollfd>&);
+    void HandleOutputEvents(const vector<struct pollfd>&, unsigned int);
+    bool PrintOutput(Job&, ostream&, bool);
+    bool PrintFinishedOutput(int, ostream&);
+    void ClearFinishedOutputs();
+    void CloseOutputs();
 
     int GetActiveJobs() { return jobsList.size(); };
 };
@@ -0,0 +1,119 @@
+#include "record.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+
+#include <cstring>
+
+using namespace std;
+
+static const char MAGIC[8] = { 'S', 'H', 'R', 'E', 'C', 0, 0, 2 };
+
+SessionRecorder::SessionRecorder():
+    fd(-1) {
+
+}
+
+SessionRecorder::~SessionRecorder() {
+    Close();
+}
+
+bool SessionRecorder::Open(const string& path) {
+    Close();
+    fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd == -1)
+        return false;
+    if (write(fd, MAGIC, sizeof(MAGIC)) != sizeof(MAGIC)) {
+        Close();
+        return false;
+    }
+    return true;
+}
+
+/* Satu write per record. Sengaja tanpa buffer stdio, child hasil fork yang
+   memanggil exit() tidak boleh ikut menulis ulang isi buffer.  */
+bool SessionRecorder::Write(const SessionRecord& record) {
+    if (fd == -1)
+        return false;
+    uint32_t length = record.line.size();
+    string buffer;
+    buffer.reserve(24 + length);
+    buffer.append((const char*) &record.offset, sizeof(record.offset));
+    buffer.append((const char*) &record.latency, sizeof(record.latency));
+    buffer.append((const char*) &record.status, sizeof(record.status));
+    buffer.append((const char*) &length, sizeof(length));
+    buffer.append(record.line);
+
+    size_t written = 0;
+    while (written < buffer.size()) {
+        ssize_t n = write(fd, buffer.data() + written, buffer.size() - written);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0)
+            return false;
+        written += n;
+    }
+    return true;
+}
+
+void SessionRecorder::Close() {
+    if (fd != -1)
+        close(fd);
+    fd = -1;
+}
+
+SessionReader::SessionReader():
+    position(0) {
+
+}
+
+bool SessionReader::Open(const string& path) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+        return false;
+    data.clear();
+    char buffer[65536];
+    ssize_t n;
+    while ((n = read(fd, buffer, sizeof(buffer))) != 0) {
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0) {
+            close(fd);
+            return false;
+        }
+        data.insert(data.end(), buffer, buffer + n);
+    }
+    close(fd);
+
+    if (data.size() < sizeof(MAGIC) || memcmp(&data[0], MAGIC, sizeof(MAGIC)) != 0) {
+        errno = EINVAL;
+        return false;
+    }
+    position = sizeof(MAGIC);
+    return true;
+}
+
+bool SessionReader::Next(SessionRecord& record) {
+    const size_t HEADER = sizeof(record.offset) + sizeof(record.latency) + sizeof(record.status) + sizeof(uint32_t);
+    if (data.size() - position < HEADER)
+        return false;
+    uint32_t length;
+    memcpy(&record.offset, &data[position], sizeof(record.offset));
+    position += sizeof(record.offset);
+    memcpy(&record.latency, &data[position], sizeof(record.latency));
+    position += sizeof(record.latency);
+    memcpy(&record.status, &data[position], sizeof(record.status));
+    position += sizeof(record.status);
+    memcpy(&length, &data[position], sizeof(length));
+    position += sizeof(length);
+
+    // Record terakhir yang terpotong diabaikan
+    if (data.size() - position < length) {
+        position = data.size();
+        return false;
+    }
+    record.line.assign(data.begin() + position, data.begin() + position + length);
+    position += length;
+    return true;
+}
@@ -0,0 +1,51 @@
+#ifndef RECORD_H
+#define RECORD_H
+
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+using namespace std;
+
+/* Rekaman sesi shell, format biner:
+     header   8 byte magic "SHREC\0\0\2"
+     record   uint64 offset (ns sejak awal sesi), uint64 latency (ns),
+              int32 exit status, uint32 panjang, lalu isi baris command
+              diikuti baris here-document, masing-masing diawali '\n'
+   Latency dihitung setelah isi here-document selesai dibaca.
+   Angka disimpan dengan byte order mesin yang merekam.  */
+struct SessionRecord {
+    uint64_t offset;
+    uint64_t latency;
+    int32_t status;
+    string line;
+};
+
+class SessionRecorder {
+private:
+    int fd;
+
+public:
+    SessionRecorder();
+    ~SessionRecorder();
+
+    bool Open(const string&);
+    bool Write(const SessionRecord&);
+    void Close();
+    bool IsOpen() const { return fd != -1; };
+};
+
+class SessionReader {
+private:
+    vector<char> data;
+    size_t position;
+
+public:
+    SessionReader();
+
+    bool Open(const string&);
+    bool Next(SessionRecord&);
+};
+
+#endif
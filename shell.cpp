@@ -4,20 +4,47 @@ using namespace std;
 
 Shell* Shell::instance;
 
-Shell::Shell():
+static long long monotonicNanoseconds() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+static long long monotonicMilliseconds() {
+    return monotonicNanoseconds() / 1000000;
+}
+
+Shell::Shell(bool interactive):
     MAX_BUFFER(1024),
     MAX_HISTORY(10),
     STRING_TILDE("~") {
 
     instance = this;
     historyIndex = 0;
+    lastStatus = 0;
+    cgroupCount = 0;
+    spreadNext = 0;
+    optionSpread = false;
+    optionControl = false;
+    optionCapture = false;
+    timerFd = -1;
+    controlSocket = -1;
+    commandStarted = 0;
+    replaying = false;
+
+    /* Pipe SIGCHLD baru dibuat sebelum fork pertama, lihat watchChildren.  */
+    childPipe[0] = childPipe[1] = -1;
     exitNow = false;
-    ENV_HOME = getenv("HOME");
-    ENV_PATH = getenv("PATH");
+    const char* home = getenv("HOME");
+    const char* path = getenv("PATH");
+    ENV_HOME = home ? home : "/";
+    ENV_PATH = path ? path : "";
 
-    /* See if we are running interactively.  */
+    /* See if we are running interactively.  Shell -c tidak pernah interaktif,
+       jadi tidak perlu menunggu foreground, ambil terminal, atau ubah termios.  */
     shell_terminal = STDIN_FILENO;
-    shell_is_interactive = isatty (shell_terminal);
+    shell_pgid = getpgrp ();
+    shell_is_interactive = interactive && isatty (shell_terminal);
 
     if (shell_is_interactive) {
         /* Loop until we are in the foreground.  */
@@ -30,7 +57,6 @@ Shell::Shell():
         signal (SIGTSTP, SIG_IGN);
         signal (SIGTTIN, SIG_IGN);
         signal (SIGTTOU, SIG_IGN);
-        signal (SIGCHLD, &SIGCHLD_HANDLER_STATIC);
 
         /* Put ourselves in our own process group.  */
         shell_pgid = getpid ();
@@ -40,7 +66,7 @@ Shell::Shell():
         }
 
         /* Grab control of the terminal.  */
-        tcsetpgrp (shell_terminal, shell_pgid);
+        giveTerminal (shell_pgid);
 
         /* Save default terminal attributes for shell.  */
         tcgetattr (shell_terminal, &shell_tmodes);
@@ -50,6 +76,7 @@ Shell::Shell():
 }
 
 Shell::~Shell() {
+    closeControlSocket();
     resetTermios();
 }
 
@@ -57,42 +84,70 @@ void Shell::SIGCHLD_HANDLER_STATIC(int sig) {
     instance->SIGCHLD_HANDLER(sig);
 }
 
+/* Handler cuma membangunkan event loop, status child diambil di reapJobs.
+   Dengan begitu waitpid tidak berebut dengan waitJob atau pipeline,
+   dan exit status job foreground tidak hilang.  */
 void Shell::SIGCHLD_HANDLER(int sig) {
-    pid_t pid;
-    int terminationStatus;
-    pid = waitpid(WAIT_ANY, &terminationStatus, WUNTRACED | WNOHANG);
-    if (pid > 0) {
-        Job job;
-        if (!jobManager.Get(pid, job))
-            return;
+    int savedErrno = errno;
+    if (childPipe[1] != -1)
+        write(childPipe[1], "", 1);
+    errno = savedErrno;
+}
+
+/* SIGCHLD handler menulis ke pipe ini supaya event loop ikut bangun.
+   Dipasang sebelum fork pertama, jadi shell -c yang hanya menjalankan
+   builtin tidak perlu membuat pipe maupun memasang handler.  */
+void Shell::watchChildren() {
+    if (childPipe[0] != -1)
+        return;
+    if (pipe2(childPipe, O_NONBLOCK | O_CLOEXEC) < 0) {
+        childPipe[0] = childPipe[1] = -1;
+        cerr << "error: couldn't create SIGCHLD pipe: " << strerror(errno) << endl;
+        return;
+    }
+    signal (SIGCHLD, &SIGCHLD_HANDLER_STATIC);
+}
+
+void Shell::reapJobs() {
+    vector<Job> jobs;
+    jobManager.GetAll(jobs);
+    for (unsigned int i = 0; i < jobs.size(); ++i) {
+        Job& job = jobs[i];
+        pid_t pid = job.pid;
+        int terminationStatus;
+        if (waitpid(pid, &terminationStatus, WUNTRACED | WNOHANG) <= 0)
+            continue;
+        if (job.status == JobForeground)
+            lastStatus = exitCode(terminationStatus);
         if (WIFEXITED(terminationStatus)) {
-            if (job.status == JobBackground) {
+            // Job foreground dihapus oleh waitJob
+            if (job.status != JobForeground) {
                 cout << "[" << job.id+1 << "]+  Done\t   " << job.name << endl;
-                jobManager.Delete(job);
+                deleteJob(job);
             }
         }
         else if (WIFSIGNALED(terminationStatus)) {
             cout << "[" << job.id+1 << "]+  Killed\t   " << job.name << endl;
-            jobManager.Delete(job);
+            deleteJob(job);
         }
         else if (WIFSTOPPED(terminationStatus)) {
             if (job.status == JobBackground) {
-                tcsetpgrp(shell_terminal, shell_pgid);
+                giveTerminal(shell_pgid);
                 jobManager.Change(pid, JobWaitingInput);
                 cout << "[" << job.id+1 << "]+  Suspended\t   " << job.name << endl;
             }
             else {
-                tcsetpgrp(shell_terminal, job.pgid);
+                giveTerminal(job.pgid);
                 jobManager.Change(pid, JobSuspended);
                 cout << "[" << job.id+1 << "]+  Stopped\t   " << job.name << endl;
             }
-            return;
+            continue;
         }
         else {
-            if (job.status == JobBackground)
-                jobManager.Delete(job);
+            if (job.status != JobForeground)
+                deleteJob(job);
         }
-        tcsetpgrp(shell_terminal, shell_pgid);
+        giveTerminal(shell_pgid);
     }
 }
 
@@ -149,9 +204,31 @@ vector<string> Shell::parseCommand(const string& cmdLine) const {
             CHAR_TAB('\t'),
             CHAR_SPACE_REPLACEMENT(1);
         bool isQuoted = false;
+        int substitutionDepth = 0;
         string cmdResult = cmdLine;
         for (unsigned int i = 0; i < cmdResult.size(); ++i) {
-            if (isQuoted) {
+            // Isi $(...) dibiarkan utuh, di-parse lagi waktu substitusi
+            if (substitutionDepth) {
+                switch (cmdResult[i]) {
+                case '(':
+                    ++substitutionDepth;
+                    break;
+                case ')':
+                    --substitutionDepth;
+                    break;
+                case CHAR_SPACE:
+                case CHAR_TAB:
+                    cmdResult[i] = CHAR_SPACE_REPLACEMENT;
+                    break;
+                }
+            }
+            else if (cmdResult[i] == '$' && i+1 < cmdResult.size() && cmdResult[i+1] == '(') {
+                if (isQuoted)
+                    cmdResult[i] = CHAR_QUOTED_SUBSTITUTION;
+                substitutionDepth = 1;
+                ++i;
+            }
+            else if (isQuoted) {
                 switch (cmdResult[i]) {
                 case CHAR_SPACE:
                 case CHAR_TAB:
@@ -187,19 +264,30 @@ vector<string> Shell::parseCommand(const string& cmdLine) const {
 
 void Shell::executeCommand(vector<string>& vCommand) {
     if (vCommand.size()) {
+        // Builtin yang berhasil dan job background berstatus 0, error mengubahnya jadi 1.
+        // exit tanpa argumen tetap memakai status terakhir.
+        if (vCommand[0] != "exit")
+            lastStatus = 0;
+
         // exit
-        if (vCommand[0] == "exit")
+        if (vCommand[0] == "exit") {
             exitNow = true;
+            if (vCommand.size() > 1)
+                lastStatus = atoi(vCommand[1].c_str()) & 0xff;
+        }
         // cd
         else if (vCommand[0] == "cd") {
             if (vCommand.size() > 1) {
-                if (vCommand[1] == STRING_TILDE)
-                    chdir(ENV_HOME.c_str());
-                else if (chdir(vCommand[1].c_str()) < 0)
+                const string& directory = vCommand[1] == STRING_TILDE ? ENV_HOME : vCommand[1];
+                if (chdir(directory.c_str()) < 0) {
                     cerr << "cd: " << vCommand[1] << ": " << strerror(errno) << endl;
+                    lastStatus = 1;
+                }
+            }
+            else if (chdir(ENV_HOME.c_str()) < 0) {
+                cerr << "cd: " << ENV_HOME << ": " << strerror(errno) << endl;
+                lastStatus = 1;
             }
-            else
-                chdir(ENV_HOME.c_str());
         }
         // TODO LIST
         /*
@@ -208,7 +296,37 @@ void Shell::executeCommand(vector<string>& vCommand) {
         */
         // jobs
         else if (vCommand[0] == "jobs") {
-            jobManager.Print();
+            if (vCommand.size() > 1 && vCommand[1] == "-o") {
+                Job job;
+                if (vCommand.size() != 3) {
+                    cerr << "jobs: usage: jobs -o %job" << endl;
+                    lastStatus = 1;
+                    return;
+                }
+                // Job yang sudah selesai masih bisa dilihat output-nya sekali
+                int jobId = vCommand[2][0] == '%' ? atoi(vCommand[2].c_str()+1) : 0;
+                if (jobId && !jobManager.Get(job, jobId-1) && jobManager.PrintFinishedOutput(jobId-1, cout)) {
+                    cout.flush();
+                    return;
+                }
+                if (!findJob("jobs", vCommand[2], job)) {
+                    lastStatus = 1;
+                    return;
+                }
+                if (!jobManager.PrintOutput(job, cout, false)) {
+                    cerr << "jobs: " << vCommand[2] << ": output not captured" << endl;
+                    lastStatus = 1;
+                }
+                cout.flush();
+            }
+            else if (vCommand.size() == 2 && vCommand[1] == "-c")
+                jobManager.ClearFinishedOutputs();
+            else if (vCommand.size() > 1) {
+                cerr << "jobs: usage: jobs [-o %job | -c]" << endl;
+                lastStatus = 1;
+            }
+            else
+                jobManager.Print();
         }
         // fg
         else if (vCommand[0] == "fg") {
@@ -217,16 +335,28 @@ void Shell::executeCommand(vector<string>& vCommand) {
             if (vCommand.size() == 1)
                 gotJob = jobManager.GetLastJob(job);
             else {
-                stringstream ss(vCommand[1]);
+                // "fg 1" dan "fg %1" sama-sama nomor job
+                const string& spec = vCommand[1];
+                stringstream ss(spec.size() && spec[0] == '%' ? spec.substr(1) : spec);
                 int jobId = -1;
                 ss >> jobId;
                 gotJob = jobManager.Get(job, jobId-1);
+                // Job capture yang sudah selesai: output-nya saja yang diputar ulang
+                if (!gotJob && jobManager.PrintFinishedOutput(jobId-1, cout)) {
+                    cout.flush();
+                    return;
+                }
                 if (!gotJob) {
                     cerr << "fg: " << jobId << ": no such job" << endl;
                 }
             }
-            if (!gotJob)
+            if (!gotJob) {
+                lastStatus = 1;
                 return;
+            }
+            // Output yang tertangkap diputar ulang dulu, sisanya langsung ke terminal
+            jobManager.PrintOutput(job, cout, true);
+            cout.flush();
             if (job.status == JobSuspended || job.status == JobWaitingInput)
                 putJobForeground(job, true);
             else
@@ -236,6 +366,20 @@ void Shell::executeCommand(vector<string>& vCommand) {
         else if (vCommand[0] == "kill") {
             Job job;
             bool gotJob;
+            int sig = SIGKILL;
+            if (vCommand.size() > 2 && vCommand[1] == "-s") {
+                sig = parseSignal(vCommand[2]);
+                vCommand.erase(vCommand.begin()+1, vCommand.begin()+3);
+            }
+            else if (vCommand.size() > 1 && vCommand[1].size() > 1 && vCommand[1][0] == '-') {
+                sig = parseSignal(vCommand[1].substr(1));
+                vCommand.erase(vCommand.begin()+1);
+            }
+            if (sig < 0) {
+                cerr << "kill: invalid signal specification" << endl;
+                lastStatus = 1;
+                return;
+            }
             if (vCommand.size() == 1)
                 gotJob = jobManager.GetLastJob(job);
             else {
@@ -256,9 +400,106 @@ void Shell::executeCommand(vector<string>& vCommand) {
                         cerr << "kill: " << value << ": no such PID" << endl;
                 }
             }
-            if (!gotJob)
+            if (!gotJob || !killJob(job, sig))
+                lastStatus = 1;
+        }
+        // taskset -p, pindahkan job yang sudah jalan ke CPU lain
+        else if (vCommand[0] == "taskset" && vCommand.size() > 1 && vCommand[1] == "-p") {
+            Job job;
+            vector<int> cpus;
+            if (vCommand.size() != 4) {
+                cerr << "taskset: usage: taskset -p cpu-list %job" << endl;
+                lastStatus = 1;
+                return;
+            }
+            if (!parseCpuList("taskset", vCommand[2], cpus) || !findJob("taskset", vCommand[3], job) ||
+                !setJobAffinity(job, cpus))
+                lastStatus = 1;
+        }
+        // renice
+        else if (vCommand[0] == "renice") {
+            Job job;
+            if (vCommand.size() > 1 && vCommand[1] == "-n")
+                vCommand.erase(vCommand.begin()+1);
+            if (vCommand.size() != 3) {
+                cerr << "renice: usage: renice [-n] priority %job" << endl;
+                lastStatus = 1;
+                return;
+            }
+            char* end;
+            long niceness = strtol(vCommand[1].c_str(), &end, 10);
+            if (*end || vCommand[1].empty()) {
+                cerr << "renice: " << vCommand[1] << ": invalid priority" << endl;
+                lastStatus = 1;
+                return;
+            }
+            if (!findJob("renice", vCommand[2], job)) {
+                lastStatus = 1;
+                return;
+            }
+            if (setpriority(job.pgid ? PRIO_PGRP : PRIO_PROCESS, job.pgid ? job.pgid : job.pid, niceness) < 0) {
+                cerr << "renice: " << job.pid << ": " << strerror(errno) << endl;
+                lastStatus = 1;
+                return;
+            }
+            job.options.hasNiceness = true;
+            job.options.niceness = niceness;
+            jobManager.Change(job.pid, job.options);
+        }
+        // set -o / set +o
+        else if (vCommand[0] == "set") {
+            if (vCommand.size() == 1 || (vCommand.size() == 2 && vCommand[1] == "-o")) {
+                printShellOptions();
+                return;
+            }
+            if (vCommand.size() != 3 || (vCommand[1] != "-o" && vCommand[1] != "+o")) {
+                cerr << "set: usage: set [-o|+o] option" << endl;
+                lastStatus = 1;
+                return;
+            }
+            bool* option = shellOption(vCommand[2]);
+            if (!option) {
+                cerr << "set: " << vCommand[2] << ": invalid option name" << endl;
+                lastStatus = 1;
+                return;
+            }
+            bool enable = vCommand[1] == "-o";
+            if (option == &optionControl && enable != optionControl) {
+                if (enable && !openControlSocket()) {
+                    lastStatus = 1;
+                    return;
+                }
+                if (!enable)
+                    closeControlSocket();
+            }
+            *option = enable;
+        }
+        // ulimit, nice, ionice, taskset
+        // tanpa command mengubah/menampilkan setting shell, dengan command hanya untuk command itu
+        else if (isJobOptionPrefix(vCommand[0])) {
+            string prefix = vCommand[0];
+            JobOptions options;
+            if (!parseJobOptions(vCommand, options)) {
+                lastStatus = 1;
                 return;
-            killJob(job);
+            }
+            if (vCommand.size()) {
+                pendingOptions = options;
+                executeCommand(vCommand);
+                pendingOptions = JobOptions();
+            }
+            else if (prefix == "ulimit") {
+                if (options.HasLimits())
+                    lastStatus = !setShellLimits(options);
+                else
+                    printShellLimits();
+            }
+            else if (prefix == "nice")
+                cout << getpriority(PRIO_PROCESS, 0) << endl;
+            else {
+                cerr << prefix << ": expected command" << endl;
+                lastStatus = 1;
+            }
         }
         // Selain built-in command
         else {
@@ -274,6 +515,7 @@ void Shell::executeCommand(vector<string>& vCommand) {
                         if (i == vCommand.size()-1) {
                             cerr << "pipelining: syntax error, expected command after '|'" << endl;
                             cerr.flush();
+                            lastStatus = 1;
                             return;
                         }
                         else {
@@ -288,25 +530,69 @@ void Shell::executeCommand(vector<string>& vCommand) {
                     }
                 }
 
+                // Limit dan penjadwalan per command, prefix di depan pipeline untuk command pertama
+                vector<JobOptions> vOptions(vCommandPipe.size());
+                vOptions[0] = pendingOptions;
+                for (unsigned int i = 0; i < vCommandPipe.size(); ++i) {
+                    if (!parseJobOptions(vCommandPipe[i], vOptions[i])) {
+                        lastStatus = 1;
+                        return;
+                    }
+                    if (vCommandPipe[i].empty()) {
+                        cerr << "pipelining: syntax error, expected command after '|'" << endl;
+                        lastStatus = 1;
+                        return;
+                    }
+                }
+
+                // Sebar command yang tidak di-pin ke CPU secara round-robin
+                if (optionSpread) {
+                    vector<int> cpus = allowedCpus();
+                    for (unsigned int i = 0; cpus.size() && i < vOptions.size(); ++i)
+                        if (vOptions[i].affinity.empty())
+                            vOptions[i].affinity.push_back(cpus[spreadNext++ % cpus.size()]);
+                }
+
+                // Here-document hanya untuk command pertama
+                for (unsigned int i = 1; i < vCommandPipe.size(); ++i)
+                    for (unsigned int j = 0; j < vCommandPipe[i].size(); ++j)
+                        if (vCommandPipe[i][j] == "<<" || vCommandPipe[i][j] == "<<<") {
+                            cerr << "here-document: syntax error, '" << vCommandPipe[i][j] << "' only allowed in the first command of a pipeline" << endl;
+                            lastStatus = 1;
+                            return;
+                        }
+                int hereDocument;
+                if (!extractHereDocument(vCommandPipe[0], hereDocument)) {
+                    lastStatus = 1;
+                    return;
+                }
+
                 int npipes = 2*(vCommandPipe.size()-1);
                 int pipes[npipes];
-                for (int i = 0; i < npipes; ++i)
+                for (int i = 0; i < npipes/2; ++i)
                     if (pipe(pipes + 2*i) < 0) {
                         cerr << "pipelining: error, couldn't pipe" << endl;
                         cerr.flush();
                     }
 
+                watchChildren();
                 vector<pid_t> vPID;
-                for (int i = 0; i < vCommandPipe.size(); ++i) {
+                bool forkFailed = false;
+                for (int i = 0; !forkFailed && i < vCommandPipe.size(); ++i) {
+                    if (vOptions[i].HasLimits() && !createCgroup(vOptions[i]) && vOptions[i].cpuQuota) {
+                        cerr << "ulimit: cgroup v2 unavailable, cpu quota ignored" << endl;
+                        vOptions[i].cpuQuota = 0;
+                    }
 
                     pid_t pid = fork();
                     if (pid == 0) {
                         resetTermios();
+                        applyJobOptions(vOptions[i]);
 
                         char** args;
                         args = new char*[vCommandPipe[i].size()+1];
                         for (unsigned int j = 0; j < vCommandPipe[i].size(); ++j) {
-                            args[j] = new char[vCommandPipe[i].size()+1];
+                            args[j] = new char[vCommandPipe[i][j].size()+1];
                             for (unsigned int k = 0; k < vCommandPipe[i][j].size(); ++k)
                                 args[j][k] = vCommandPipe[i][j][k];
                             args[j][vCommandPipe[i][j].size()] = 0;
@@ -326,33 +612,55 @@ void Shell::executeCommand(vector<string>& vCommand) {
                             if (dup2(pipes[2*(i-1)], STDIN_FILENO) < 0)
                                 exit(EXIT_FAILURE);
                         }
+                        else if (hereDocument != -1) {
+                            if (dup2(hereDocument, STDIN_FILENO) < 0)
+                                exit(EXIT_FAILURE);
+                        }
 
                         for (int j = 0; j < npipes; ++j)
                             close(pipes[j]);
 
-                        int execStatus = execvp(args[0], args);
-                        if (execStatus < 0) {
-                            cerr << args[0] << ": " << strerror(errno) << endl;
-                            cerr.flush();
-                        }
+                        execvp(args[0], args);
+                        cerr << args[0] << ": " << strerror(errno) << endl;
+                        cerr.flush();
                         delete [] args;
-                        exit(execStatus);
+                        exit(127);
                     }
-                    else if (pid > 0)
+                    else if (pid > 0) {
                         vPID.push_back(pid);
+                        // Command di pipeline ada di process group shell, jadi signal ke pid saja
+                        if (vOptions[i].timeout)
+                            addDeadline(pid, false, vOptions[i]);
+                    }
                     else {
                         cerr << "fork: failed to create child process" << endl;
-                        return;
+                        forkFailed = true;
                     }
                 }
 
                 /* Main process nunggu anaknya mati :( */
                 for (int i = 0; i < npipes; ++i)
                     close(pipes[i]);
-                for (int i = 0 ; i < vPID.size(); ++i) {
+                if (hereDocument != -1)
+                    close(hereDocument);
+                // Pipeline tidak lengkap, command yang sudah jalan dihentikan lalu tetap ditunggu
+                if (forkFailed)
+                    for (unsigned int i = 0; i < vPID.size(); ++i)
+                        kill(vPID[i], SIGTERM);
+                for (unsigned int i = 0; i < vPID.size(); ++i) {
                     int status;
-                    waitpid(vPID[i], &status, 0);
+                    pid_t waited;
+                    while ((waited = waitpid(vPID[i], &status, WNOHANG)) == 0)
+                        serviceEvents(false, -1);
+                    if (waited > 0 && i == vPID.size()-1)
+                        lastStatus = exitCode(status);
+                    removeDeadline(vPID[i]);
                 }
+                for (unsigned int i = 0; i < vOptions.size(); ++i)
+                    if (vOptions[i].cgroup.size())
+                        rmdir(vOptions[i].cgroup.c_str());
+                if (forkFailed)
+                    lastStatus = 1;
             }
             else {
                 // Background process
@@ -364,6 +672,24 @@ void Shell::executeCommand(vector<string>& vCommand) {
 
                 }
 
+                int hereDocument;
+                if (!extractHereDocument(vCommand, hereDocument)) {
+                    lastStatus = 1;
+                    return;
+                }
+
+                JobOptions options = pendingOptions;
+                if (options.HasLimits() && !createCgroup(options) && options.cpuQuota) {
+                    cerr << "ulimit: cgroup v2 unavailable, cpu quota ignored" << endl;
+                    options.cpuQuota = 0;
+                }
+
+                // stdout/stderr job background masuk ring buffer
+                int capturePipe[2] = { -1, -1 };
+                if (background && optionCapture && pipe2(capturePipe, O_CLOEXEC) < 0)
+                    cerr << "capture: " << strerror(errno) << endl;
+
+                watchChildren();
                 int status;
                 pid_t pid = fork();
                 if (pid == 0) {
@@ -373,13 +699,13 @@ void Shell::executeCommand(vector<string>& vCommand) {
                         if (vCommand[i] == "<") {
                             if (i == vCommand.size()-1) {
                                 cerr << "redirect stdin: syntax error, expected filename after '<'" << endl;
-                                return;
+                                exit(EXIT_FAILURE);
                             }
                             else {
                                 fileInput = open(vCommand[i+1].c_str(), O_RDONLY);
                                 if (fileInput == -1) {
                                     cerr << "redirect stdin: couldn't open the file '" << vCommand[i+1] << "'" <<  endl;
-                                    return;
+                                    exit(EXIT_FAILURE);
                                 }
                                 vCommand.erase(vCommand.begin()+i);
                                 vCommand.erase(vCommand.begin()+i);
@@ -387,19 +713,23 @@ void Shell::executeCommand(vector<string>& vCommand) {
                         }
                     }
 
+                    // Here-document dipakai kalau tidak ada '<'
+                    if (fileInput == -1)
+                        fileInput = hereDocument;
+
                     // STDOUT, diubah sesuai yang ada di reference
                     int fileOutput = -1;
                     for (unsigned int i = 0; fileOutput == -1 && i < vCommand.size(); ++i) {
                         if (vCommand[i] == ">") {
                             if (i == vCommand.size()-1) {
                                 cerr << "redirect stdout: syntax error, expected filename after '>'" << endl;
-                                return;
+                                exit(EXIT_FAILURE);
                             }
                             else {
                                 fileOutput = open(vCommand[i+1].c_str(), O_WRONLY | O_CREAT, S_IRWXU | S_IRWXG | S_IRWXO);
                                 if (fileOutput == -1) {
                                     cerr << "redirect stdout: couldn't open the file '" << vCommand[i+1] << "'" << endl;
-                                    return;
+                                    exit(EXIT_FAILURE);
                                 }
                                 vCommand.erase(vCommand.begin()+i);
                                 vCommand.erase(vCommand.begin()+i);
@@ -407,12 +737,14 @@ void Shell::executeCommand(vector<string>& vCommand) {
                         }
                     }
 
-                    setpgrp();
+                    // Tanpa job control, command tetap di process group shell
+                    if (shell_is_interactive)
+                        setpgrp();
                     if (background)
                         cout << endl << "[" << jobManager.GetActiveJobs() << "] " << getpid() << endl;
                     else {
                         resetTermios();
-                        tcsetpgrp(shell_terminal, pid);
+                        giveTerminal(getpid());
                     }
 
                     /* Set the handling for job control signals back to the default.  */
@@ -423,6 +755,8 @@ void Shell::executeCommand(vector<string>& vCommand) {
                     signal (SIGTTOU, SIG_DFL);
                     signal (SIGCHLD, &SIGCHLD_HANDLER_STATIC);
 
+                    applyJobOptions(options);
+
                     char** args;
                     args = new char*[vCommand.size()+1];
                     for (unsigned int i = 0; i < vCommand.size(); ++i) {
@@ -433,6 +767,10 @@ void Shell::executeCommand(vector<string>& vCommand) {
                     }
                     args[vCommand.size()] = 0;
 
+                    if (capturePipe[1] != -1) {
+                        dup2(capturePipe[1], STDOUT_FILENO);
+                        dup2(capturePipe[1], STDERR_FILENO);
+                    }
                     if (fileInput != -1) {
                         close(STDIN_FILENO);
                         dup(fileInput);
@@ -442,9 +780,8 @@ void Shell::executeCommand(vector<string>& vCommand) {
                         dup(fileOutput);
                     }
 
-                    int execStatus = execvp(args[0], args);
-                    if (execStatus < 0)
-                        cerr << args[0] << ": " << strerror(errno) << endl;
+                    execvp(args[0], args);
+                    cerr << args[0] << ": " << strerror(errno) << endl;
 
                     // Cleanup
                     delete [] args;
@@ -453,11 +790,22 @@ void Shell::executeCommand(vector<string>& vCommand) {
                     if (fileOutput != -1)
                         close(fileOutput);
 
-                    exit(execStatus);
+                    exit(127);
                 }
                 else if (pid > 0) {
-                    setpgid(pid, pid);
-                    Job job = jobManager.Insert(pid, pid, vCommand[0], background ? JobBackground : JobForeground);
+                    if (hereDocument != -1)
+                        close(hereDocument);
+                    pid_t pgid = shell_is_interactive ? pid : 0;
+                    if (pgid)
+                        setpgid(pid, pgid);
+                    Job job = jobManager.Insert(pid, pgid, vCommand[0], background ? JobBackground : JobForeground, options);
+                    if (capturePipe[0] != -1) {
+                        close(capturePipe[1]);
+                        fcntl(capturePipe[0], F_SETFL, O_NONBLOCK);
+                        jobManager.AttachOutput(pid, capturePipe[0]);
+                    }
+                    if (options.timeout)
+                        addDeadline(pid, true, options);
                     if (background)
                         putJobBackground(job, false);
                     else
@@ -465,6 +813,15 @@ void Shell::executeCommand(vector<string>& vCommand) {
                 }
                 else {
                     cerr << "fork: failed to create child process" << endl;
+                    lastStatus = 1;
+                    if (hereDocument != -1)
+                        close(hereDocument);
+                    if (options.cgroup.size())
+                        rmdir(options.cgroup.c_str());
+                    if (capturePipe[0] != -1) {
+                        close(capturePipe[0]);
+                        close(capturePipe[1]);
+                    }
                 }
             }
         }
@@ -472,6 +829,9 @@ void Shell::executeCommand(vector<string>& vCommand) {
 }
 
 void Shell::printPrompt() {
+    if (!shell_is_interactive)
+        return;
+
     char currentDirectory[MAX_BUFFER];
 
     // Shell menunjukkan lokasi dan direktori saat ini
@@ -490,25 +850,146 @@ void Shell::runShell() {
         string cmdPromptString;
         cmdPromptString = readline();
         cmdPromptString = trimCommand(cmdPromptString);
-        if (cmdPromptString.size()) {
+        if (shell_is_interactive && cmdPromptString.size()) {
             if (historyCommand.size() == 0 || historyCommand[historyCommand.size()-1] != cmdPromptString)
                 historyCommand.push_back(cmdPromptString);
             historyIndex = historyCommand.size();
         }
-        vector<string> vcmdPromptString = parseCommand(cmdPromptString);
-        executeCommand(vcmdPromptString);
+        long long started = monotonicNanoseconds();
+        hereDocumentInput.clear();
+        executeLine(cmdPromptString);
+        if (recorder.IsOpen() && cmdPromptString.size()) {
+            // Latency dihitung setelah isi here-document selesai diketik
+            SessionRecord record;
+            record.offset = started - sessionStart;
+            record.latency = monotonicNanoseconds() - commandStarted;
+            record.status = lastStatus;
+            record.line = cmdPromptString;
+            for (unsigned int i = 0; i < hereDocumentInput.size(); ++i)
+                record.line += '\n' + hereDocumentInput[i];
+            if (!recorder.Write(record)) {
+                cerr << "record: " << strerror(errno) << ", recording stopped" << endl;
+                recorder.Close();
+            }
+        }
 	} while (!exitNow);
 }
 
+void Shell::executeLine(const string& cmdLine) {
+    vector<string> vcmdPromptString = parseCommand(cmdLine);
+    bool ready = readHereDocuments(vcmdPromptString);
+    commandStarted = monotonicNanoseconds();
+    if (ready && expandSubstitutions(vcmdPromptString))
+        executeCommand(vcmdPromptString);
+    else
+        lastStatus = 1;
+}
+
+int Shell::getLastStatus() const {
+    return lastStatus;
+}
+
+bool Shell::startRecording(const string& path) {
+    if (!recorder.Open(path)) {
+        cerr << "record: " << path << ": " << strerror(errno) << endl;
+        return false;
+    }
+    sessionStart = monotonicNanoseconds();
+    return true;
+}
+
+static double percentile(const vector<long long>& sorted, double fraction) {
+    if (sorted.empty())
+        return 0;
+    unsigned int index = fraction * (sorted.size()-1) + 0.5;
+    return sorted[index] / 1e6;
+}
+
+/* Jalankan ulang rekaman lewat executeLine. speed 1 = kecepatan asli,
+   2 = dua kali lebih cepat, 0 = secepatnya tanpa jeda.
+   Isi here-document diambil dari rekaman, stdin tidak pernah dibaca.
+   Laporan ditulis ke stderr supaya tidak tercampur output command.  */
+int Shell::replaySession(const string& path, double speed) {
+    SessionReader reader;
+    if (!reader.Open(path)) {
+        cerr << "replay: " << path << ": " << strerror(errno) << endl;
+        return 1;
+    }
+
+    vector<long long> latencies, recordedLatencies;
+    int mismatches = 0;
+    replaying = true;
+    long long replayStart = monotonicNanoseconds();
+    SessionRecord record;
+    while (!exitNow && reader.Next(record)) {
+        if (speed > 0) {
+            // Event loop tetap jalan selama menunggu jadwal command berikutnya
+            long long target = replayStart + (long long) (record.offset / speed);
+            long long now;
+            while ((now = monotonicNanoseconds()) < target)
+                serviceEvents(false, (target - now + 999999) / 1000000);
+        }
+
+        // Baris pertama command, sisanya isi here-document
+        size_t newline = record.line.find('\n');
+        hereDocumentInput.clear();
+        if (newline != string::npos)
+            hereDocumentInput = splitCommand(record.line.substr(newline+1), '\n');
+        executeLine(record.line.substr(0, newline));
+        latencies.push_back(monotonicNanoseconds() - commandStarted);
+        recordedLatencies.push_back(record.latency);
+        if (lastStatus != record.status)
+            ++mismatches;
+    }
+    double elapsed = (monotonicNanoseconds() - replayStart) / 1e9;
+    replaying = false;
+
+    sort(latencies.begin(), latencies.end());
+    sort(recordedLatencies.begin(), recordedLatencies.end());
+    cout.flush();
+    cerr \
+    << "replay: " << latencies.size() << " commands in " << elapsed << "s, " \
+    << (elapsed > 0 ? latencies.size() / elapsed : 0) << " commands/s" << endl \
+    << "replay: latency ms p50 " << percentile(latencies, 0.5) \
+    << " p90 " << percentile(latencies, 0.9) \
+    << " p99 " << percentile(latencies, 0.99) \
+    << " max " << percentile(latencies, 1) << endl \
+    << "replay: recorded ms p50 " << percentile(recordedLatencies, 0.5) \
+    << " p90 " << percentile(recordedLatencies, 0.9) \
+    << " p99 " << percentile(recordedLatencies, 0.99) \
+    << " max " << percentile(recordedLatencies, 1) << endl \
+    << "replay: " << mismatches << " exit status mismatches" << endl;
+    return mismatches ? 1 : 0;
+}
+
+/* Kode exit seperti sh: exit status, atau 128 + nomor signal.  */
+int Shell::exitCode(int terminationStatus) {
+    if (WIFEXITED(terminationStatus))
+        return WEXITSTATUS(terminationStatus);
+    if (WIFSIGNALED(terminationStatus))
+        return 128 + WTERMSIG(terminationStatus);
+    if (WIFSTOPPED(terminationStatus))
+        return 128 + WSTOPSIG(terminationStatus);
+    return 0;
+}
+
+void Shell::giveTerminal(pid_t pgid) {
+    if (shell_is_interactive)
+        tcsetpgrp(shell_terminal, pgid);
+}
+
 static struct termios old_termios, new_termios;
 
 /* restore new terminal i/o settings */
 void Shell::resetTermios() {
-    tcsetattr(0, TCSANOW, &shell_tmodes);
+    if (shell_is_interactive)
+        tcsetattr(0, TCSANOW, &shell_tmodes);
 }
 
 /* initialize new terminal i/o settings */
 void Shell::initTermios() {
+    if (!shell_is_interactive)
+        return;
     new_termios = shell_tmodes; // assign to new setting
     new_termios.c_lflag &= ~ICANON; // disable buffer i/o
     new_termios.c_lflag &= ~ECHO; // disable echo mode
@@ -519,13 +1000,40 @@ string Shell::readline() {
     int done = 0;
     string str = "";
 
+    // Replay: isi here-document diambil dari rekaman, bukan dari stdin
+    if (replaying) {
+        if (hereDocumentInput.empty()) {
+            exitNow = true;
+            return str;
+        }
+        str = hereDocumentInput[0];
+        hereDocumentInput.erase(hereDocumentInput.begin());
+        return str;
+    }
+
+    // Input bukan terminal: tanpa echo dan tanpa history
+    if (!shell_is_interactive) {
+        int input;
+        while ((input = readChar()) != EOF && input != '\n')
+            str += input;
+        if (input == EOF && str.empty())
+            exitNow = true;
+        return str;
+    }
+
     do {
-        char cc = getchar();
+        int input = readChar();
+        if (input == EOF) {
+            exitNow = true;
+            cout << endl;
+            break;
+        }
+        char cc = input;
         switch (cc) {
             case 27:
-                if ((cc = getchar()) == 91) {
+                if ((cc = readChar()) == 91) {
                     bool historyChange = false;
-                    switch (cc = getchar()) {
+                    switch (cc = readChar()) {
                     // User pencet atas
                     case 65:
                         if (historyCommand.size()) {
@@ -581,19 +1089,78 @@ string Shell::readline() {
     return str;
 }
 
+/* Baca satu karakter dari stdin. Selama menunggu, event lain tetap dilayani.  */
+int Shell::readChar() {
+    while (!serviceEvents(true, -1));
+
+    unsigned char c;
+    ssize_t n;
+    do {
+        n = read(STDIN_FILENO, &c, 1);
+    } while (n < 0 && errno == EINTR);
+    return n == 1 ? c : EOF;
+}
+
+/* Satu putaran event loop. Menunggu sampai ada event atau timeout (ms, -1 = selamanya),
+   return true kalau stdin siap dibaca. fd tambahan dari pemanggil ikut di-poll,
+   revents-nya dikembalikan lewat extra.  */
+bool Shell::serviceEvents(bool watchInput, int timeout, vector<struct pollfd>* extra) {
+    vector<struct pollfd> fds;
+    struct pollfd fd;
+    fd.events = POLLIN;
+    fd.fd = watchInput ? STDIN_FILENO : -1;
+    fds.push_back(fd);
+    fd.fd = childPipe[0];
+    fds.push_back(fd);
+    unsigned int controlIndex = fds.size();
+    addControlEvents(fds);
+    fd.fd = timerFd;
+    fds.push_back(fd);
+    unsigned int outputIndex = fds.size();
+    jobManager.AddOutputEvents(fds);
+    unsigned int extraIndex = fds.size();
+    if (extra)
+        fds.insert(fds.end(), extra->begin(), extra->end());
+
+    if (poll(&fds[0], fds.size(), timeout) < 0) {
+        if (extra)
+            for (unsigned int i = 0; i < extra->size(); ++i)
+                (*extra)[i].revents = 0;
+        checkControlWaiters();
+        return false;
+    }
+    if (extra) {
+        for (unsigned int i = 0; i < extra->size(); ++i)
+            (*extra)[i].revents = fds[extraIndex+i].revents;
+        fds.resize(extraIndex);
+    }
+
+    if (fds[1].revents & POLLIN) {
+        char buffer[64];
+        while (read(childPipe[0], buffer, sizeof(buffer)) > 0);
+        reapJobs();
+    }
+    handleControlEvents(fds, controlIndex);
+    if (fds[outputIndex-1].revents & POLLIN)
+        handleTimer();
+    jobManager.HandleOutputEvents(fds, outputIndex);
+    checkControlWaiters();
+    return fds[0].revents & (POLLIN | POLLHUP | POLLERR);
+}
+
 void Shell::putJobForeground(Job& job, bool continueJob) {
     resetTermios();
     jobManager.Change(job.pid, JobForeground);
     job.status = JobForeground;
-    tcsetpgrp(shell_terminal, job.pgid);
+    giveTerminal(job.pgid);
     if (continueJob) {
-        if (kill(-job.pgid, SIGCONT) < 0)
+        if (kill(job.Target(), SIGCONT) < 0)
             cerr << "error: kill SIGCONT" << endl;
     }
     waitJob(job);
 
     /* Put the shell back in the foreground.  */
-    tcsetpgrp (shell_terminal, shell_pgid);
+    giveTerminal(shell_pgid);
 
     initTermios();
 }
@@ -604,24 +1171,661 @@ void Shell::putJobBackground(Job& job, bool continueJob) {
         jobManager.Change(job.pid, JobWaitingInput);
     }
     if (continueJob)
-        if (kill(-job.pgid, SIGCONT) < 0)
+        if (kill(job.Target(), SIGCONT) < 0)
             cerr << "error: kill SIGCONT" << endl;
 
-    tcsetpgrp(shell_terminal, shell_pgid);
+    giveTerminal(shell_pgid);
 }
 
 
 void Shell::waitJob(Job& job) {
     int terminationStatus;
-    while (waitpid(job.pid, &terminationStatus, WUNTRACED | WNOHANG) == 0) {
+    pid_t waited;
+    while ((waited = waitpid(job.pid, &terminationStatus, WUNTRACED | WNOHANG)) == 0) {
         jobManager.Get(job.pid, job);
         if (job.status == JobSuspended) {
             return;
         }
+        serviceEvents(false, -1);
+    }
+    if (waited > 0)
+        lastStatus = exitCode(terminationStatus);
+    // Job yang di-stop tetap di tabel supaya bisa di-fg/bg lagi
+    if (waited > 0 && WIFSTOPPED(terminationStatus)) {
+        jobManager.Change(job.pid, JobSuspended);
+        cout << "[" << job.id+1 << "]+  Stopped\t   " << job.name << endl;
+        return;
     }
+    deleteJob(job);
+}
+
+/* Deadline ikut dihapus, pid job yang sudah selesai bisa dipakai ulang process lain.  */
+void Shell::deleteJob(Job& job) {
     jobManager.Delete(job);
+    removeDeadline(job.pid);
+}
+
+/* Signal dikirim ke seluruh process group job.  */
+bool Shell::killJob(Job& job, int sig) {
+    if (kill(job.Target(), sig) < 0) {
+        cerr << "kill: " << job.pid << ": " << strerror(errno) << endl;
+        return false;
+    }
+    // Job yang di-stop harus dilanjutkan supaya signalnya diproses
+    if (job.status == JobSuspended || job.status == JobWaitingInput)
+        kill(job.Target(), SIGCONT);
+    return true;
 }
 
-void Shell::killJob(Job& job) {
-    kill(job.pid, SIGKILL);
+int Shell::parseSignal(const string& name) {
+    const struct {
+        const char* name;
+        int number;
+    } signals[] = {
+        { "HUP", SIGHUP }, { "INT", SIGINT }, { "QUIT", SIGQUIT }, { "KILL", SIGKILL },
+        { "USR1", SIGUSR1 }, { "USR2", SIGUSR2 }, { "TERM", SIGTERM }, { "CONT", SIGCONT },
+        { "STOP", SIGSTOP }, { "TSTP", SIGTSTP },
+    };
+    string upper = name;
+    for (unsigned int i = 0; i < upper.size(); ++i)
+        upper[i] = toupper(upper[i]);
+    if (upper.compare(0, 3, "SIG") == 0)
+        upper.erase(0, 3);
+    for (unsigned int i = 0; i < sizeof(signals)/sizeof(signals[0]); ++i)
+        if (upper == signals[i].name)
+            return signals[i].number;
+
+    char* end;
+    long number = strtol(name.c_str(), &end, 10);
+    if (name.empty() || *end || number <= 0 || number >= NSIG)
+        return -1;
+    return number;
+}
+
+bool Shell::readHereDocuments(vector<string>& vCommand) {
+    for (unsigned int i = 0; i < vCommand.size(); ++i) {
+        // Pisahkan "<<EOF" dan "<<<word" jadi dua token
+        size_t length = vCommand[i].compare(0, 3, "<<<") == 0 ? 3 :
+                        vCommand[i].compare(0, 2, "<<") == 0 ? 2 : 0;
+        if (!length)
+            continue;
+        if (vCommand[i].size() > length) {
+            vCommand.insert(vCommand.begin()+i+1, vCommand[i].substr(length));
+            vCommand[i].erase(length);
+        }
+        if (i == vCommand.size()-1) {
+            cerr << "here-document: syntax error, expected word after '" << vCommand[i] << "'" << endl;
+            return false;
+        }
+        if (length == 3) {
+            ++i;
+            continue;
+        }
+
+        // Baca isi here-document sampai ketemu delimiter
+        string delimiter = vCommand[i+1], body;
+        while (!exitNow) {
+            if (shell_is_interactive) {
+                cout << "> ";
+                cout.flush();
+            }
+            string line = readline();
+            // EOF sebelum delimiter, tidak ada baris yang ditambahkan
+            if (exitNow && line.empty())
+                break;
+            if (recorder.IsOpen())
+                hereDocumentInput.push_back(line);
+            if (line == delimiter)
+                break;
+            body += line;
+            body += '\n';
+        }
+        vCommand[i+1] = body;
+        ++i;
+    }
+    return true;
+}
+
+bool Shell::extractHereDocument(vector<string>& vCommand, int& fd) {
+    fd = -1;
+    for (unsigned int i = 0; i < vCommand.size(); ) {
+        bool hereString = vCommand[i] == "<<<";
+        if (!hereString && vCommand[i] != "<<") {
+            ++i;
+            continue;
+        }
+        if (i == vCommand.size()-1) {
+            cerr << "here-document: syntax error, expected word after '" << vCommand[i] << "'" << endl;
+            if (fd != -1)
+                close(fd);
+            fd = -1;
+            return false;
+        }
+
+        // Here-document terakhir yang dipakai
+        if (fd != -1)
+            close(fd);
+        fd = openHereDocument(hereString ? vCommand[i+1] + '\n' : vCommand[i+1]);
+        if (fd == -1) {
+            cerr << "here-document: " << strerror(errno) << endl;
+            return false;
+        }
+        vCommand.erase(vCommand.begin()+i);
+        vCommand.erase(vCommand.begin()+i);
+    }
+    return true;
+}
+
+/* Isi here-document ditaruh di memory, bukan di temp file.
+   Isi kecil muat di buffer pipe jadi write tidak akan block,
+   sisanya pakai memfd yang bisa dibaca dari offset 0.  */
+int Shell::openHereDocument(const string& body) {
+    int fd = -1;
+    if (body.size() <= PIPE_BUF) {
+        int fds[2];
+        if (pipe2(fds, O_CLOEXEC) == 0) {
+            if (write(fds[1], body.data(), body.size()) == (ssize_t) body.size()) {
+                close(fds[1]);
+                return fds[0];
+            }
+            close(fds[0]);
+            close(fds[1]);
+        }
+    }
+
+    fd = memfd_create("here-document", MFD_CLOEXEC);
+    if (fd == -1)
+        return -1;
+    size_t written = 0;
+    while (written < body.size()) {
+        ssize_t n = write(fd, body.data() + written, body.size() - written);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            close(fd);
+            return -1;
+        }
+        written += n;
+    }
+    lseek(fd, 0, SEEK_SET);
+    return fd;
+}
+
+bool Shell::isJobOptionPrefix(const string& word) const {
+    return word == "ulimit" || word == "nice" || word == "ionice" || word == "taskset" || word == "timeout";
+}
+
+/* Durasi seperti timeout(1): angka dengan akhiran s, m, h, atau d.
+   inf, nan, dan durasi lebih dari 100 tahun ditolak supaya tetap muat di long long.  */
+static bool parseDuration(const string& value, long long& milliseconds) {
+    const double MAX_DURATION = 100 * 365.0 * 24 * 60 * 60 * 1000;
+    char* end;
+    double duration = strtod(value.c_str(), &end);
+    if (value.empty() || end == value.c_str() || !isfinite(duration) || duration < 0)
+        return false;
+    string suffix = end;
+    if (suffix == "" || suffix == "s")
+        duration *= 1000;
+    else if (suffix == "m")
+        duration *= 60 * 1000;
+    else if (suffix == "h")
+        duration *= 60 * 60 * 1000;
+    else if (suffix == "d")
+        duration *= 24 * 60 * 60 * 1000;
+    else
+        return false;
+    if (duration > MAX_DURATION)
+        return false;
+    milliseconds = duration;
+    return true;
+}
+
+bool Shell::parseCpuList(const string& prefix, const string& list, vector<int>& cpus) const {
+    cpus.clear();
+    vector<string> ranges = splitCommand(list, ',');
+    for (unsigned int i = 0; i < ranges.size(); ++i) {
+        int first, last;
+        char dash, extra;
+        stringstream ss(ranges[i]);
+        if (!(ss >> first))
+            first = -1;
+        last = first;
+        if (ss >> dash && (dash != '-' || !(ss >> last) || ss >> extra))
+            first = -1;
+        if (first < 0 || last < first || last >= CPU_SETSIZE) {
+            cerr << prefix << ": " << list << ": invalid cpu list" << endl;
+            return false;
+        }
+        for (int cpu = first; cpu <= last; ++cpu)
+            cpus.push_back(cpu);
+    }
+    if (cpus.empty()) {
+        cerr << prefix << ": " << list << ": invalid cpu list" << endl;
+        return false;
+    }
+    return true;
+}
+
+/* Buang prefix berikut dari depan command, sisanya adalah command yang dijalankan:
+     ulimit [-t detik] [-v KiB] [-n jumlah] [-c KiB] [-Q persen]
+     nice [-n tambahan]
+     ionice [-c kelas] [-n level]
+     taskset -c cpu-list
+     timeout [-s signal] [-k durasi] durasi
+   Prefix boleh disambung, misalnya "nice -n 5 taskset -c 0-3 make".  */
+bool Shell::parseJobOptions(vector<string>& vCommand, JobOptions& options) {
+    while (vCommand.size() && isJobOptionPrefix(vCommand[0])) {
+        string prefix = vCommand[0];
+        bool niceAdjusted = false;
+        unsigned int i = 1;
+        while (i < vCommand.size() && vCommand[i].size() > 1 && vCommand[i][0] == '-') {
+            if (vCommand[i] == "--") {
+                ++i;
+                break;
+            }
+            if (i == vCommand.size()-1) {
+                cerr << prefix << ": " << vCommand[i] << ": option requires an argument" << endl;
+                return false;
+            }
+            const string& option = vCommand[i];
+            const string& value = vCommand[i+1];
+
+            if (prefix == "ulimit") {
+                rlim_t limit = RLIM_INFINITY;
+                if (value != "unlimited") {
+                    char* end;
+                    errno = 0;
+                    limit = strtoull(value.c_str(), &end, 10);
+                    if (errno || *end || value[0] == '-') {
+                        cerr << "ulimit: " << value << ": invalid number" << endl;
+                        return false;
+                    }
+                }
+
+                if (option == "-t") {
+                    options.cpu = limit;
+                    options.hasCpu = true;
+                }
+                else if (option == "-v") {
+                    options.memory = limit == RLIM_INFINITY ? limit : limit*1024;
+                    options.hasMemory = true;
+                }
+                else if (option == "-n") {
+                    options.files = limit;
+                    options.hasFiles = true;
+                }
+                else if (option == "-c") {
+                    options.core = limit == RLIM_INFINITY ? limit : limit*1024;
+                    options.hasCore = true;
+                }
+                else if (option == "-Q")
+                    options.cpuQuota = limit == RLIM_INFINITY ? 0 : limit;
+                else {
+                    cerr << "ulimit: " << option << ": invalid option" << endl;
+                    return false;
+                }
+            }
+            else if (prefix == "timeout") {
+                if (option == "-s") {
+                    options.timeoutSignal = parseSignal(value);
+                    if (options.timeoutSignal < 0) {
+                        cerr << "timeout: " << value << ": invalid signal" << endl;
+                        return false;
+                    }
+                }
+                else if (option == "-k") {
+                    if (!parseDuration(value, options.killAfter)) {
+                        cerr << "timeout: " << value << ": invalid time interval" << endl;
+                        return false;
+                    }
+                }
+                else {
+                    cerr << "timeout: " << option << ": invalid option" << endl;
+                    return false;
+                }
+            }
+            else if (prefix == "taskset") {
+                if (option != "-c") {
+                    cerr << "taskset: " << option << ": invalid option" << endl;
+                    return false;
+                }
+                if (!parseCpuList("taskset", value, options.affinity))
+                    return false;
+            }
+            else {
+                char* end;
+                long number = strtol(value.c_str(), &end, 10);
+                if (*end || value.empty()) {
+                    cerr << prefix << ": " << value << ": invalid number" << endl;
+                    return false;
+                }
+
+                if (prefix == "nice" && option == "-n") {
+                    // Sama seperti nice(1), nilainya relatif ke niceness shell
+                    long niceness = getpriority(PRIO_PROCESS, 0) + number;
+                    options.niceness = niceness < -20 ? -20 : niceness > 19 ? 19 : niceness;
+                    options.hasNiceness = true;
+                    niceAdjusted = true;
+                }
+                else if (prefix == "ionice" && option == "-c" && number >= 1 && number <= 3)
+                    options.ioClass = number;
+                else if (prefix == "ionice" && option == "-n" && number >= 0 && number <= 7)
+                    options.ioLevel = number;
+                else {
+                    cerr << prefix << ": " << option << " " << value << ": invalid option" << endl;
+                    return false;
+                }
+            }
+            i += 2;
+        }
+
+        if (prefix == "nice" && !niceAdjusted && i < vCommand.size()) {
+            long niceness = getpriority(PRIO_PROCESS, 0) + 10;
+            options.niceness = niceness > 19 ? 19 : niceness;
+            options.hasNiceness = true;
+        }
+        else if (prefix == "ionice" && options.ioClass == -1 && i < vCommand.size())
+            options.ioClass = 2;
+        else if (prefix == "taskset" && options.affinity.empty() && i < vCommand.size()) {
+            cerr << "taskset: expected -c cpu-list" << endl;
+            return false;
+        }
+        else if (prefix == "timeout" && i < vCommand.size()) {
+            if (!parseDuration(vCommand[i], options.timeout)) {
+                cerr << "timeout: " << vCommand[i] << ": invalid time interval" << endl;
+                return false;
+            }
+            ++i;
+        }
+        vCommand.erase(vCommand.begin(), vCommand.begin()+i);
+    }
+    return true;
+}
+
+/* Soft limit dipotong ke hard limit, jadi unlimited berarti naik sampai hard limit.  */
+static bool setSoftLimit(int resource, rlim_t value) {
+    struct rlimit limit;
+    if (getrlimit(resource, &limit) < 0)
+        return false;
+    limit.rlim_cur = value < limit.rlim_max ? value : limit.rlim_max;
+    return setrlimit(resource, &limit) == 0;
+}
+
+bool Shell::setShellLimits(const JobOptions& options) {
+    if (options.cpuQuota) {
+        cerr << "ulimit: -Q: only valid with a command" << endl;
+        return false;
+    }
+    bool success = true;
+    if (options.hasCpu)
+        success &= setSoftLimit(RLIMIT_CPU, options.cpu);
+    if (options.hasMemory)
+        success &= setSoftLimit(RLIMIT_AS, options.memory);
+    if (options.hasFiles)
+        success &= setSoftLimit(RLIMIT_NOFILE, options.files);
+    if (options.hasCore)
+        success &= setSoftLimit(RLIMIT_CORE, options.core);
+    if (!success)
+        cerr << "ulimit: " << strerror(errno) << endl;
+    return success;
+}
+
+void Shell::printShellLimits() {
+    const struct {
+        const char* name;
+        const char* option;
+        int resource;
+        rlim_t unit;
+    } limits[] = {
+        { "cpu time (seconds)", "-t", RLIMIT_CPU, 1 },
+        { "virtual memory (kbytes)", "-v", RLIMIT_AS, 1024 },
+        { "open files", "-n", RLIMIT_NOFILE, 1 },
+        { "core file size (kbytes)", "-c", RLIMIT_CORE, 1024 },
+    };
+    for (unsigned int i = 0; i < sizeof(limits)/sizeof(limits[0]); ++i) {
+        struct rlimit limit;
+        getrlimit(limits[i].resource, &limit);
+        cout << limits[i].name << "\t(" << limits[i].option << ") ";
+        if (limit.rlim_cur == RLIM_INFINITY)
+            cout << "unlimited" << endl;
+        else
+            cout << limit.rlim_cur / limits[i].unit << endl;
+    }
+}
+
+static bool writeCgroupFile(const string& path, const string& value) {
+    int fd = open(path.c_str(), O_WRONLY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+    bool success = write(fd, value.data(), value.size()) == (ssize_t) value.size();
+    close(fd);
+    return success;
+}
+
+/* Bikin leaf cgroup v2 di bawah $SHELL_CGROUP_ROOT (harus sudah di-delegate dan
+   controller memory/cpu aktif di cgroup.subtree_control).  */
+bool Shell::createCgroup(JobOptions& options) {
+    if (options.memory == RLIM_INFINITY && !options.cpuQuota)
+        return false;
+    const char* root = getenv("SHELL_CGROUP_ROOT");
+    if (!root || !*root)
+        return false;
+
+    stringstream path;
+    path << root << "/job-" << getpid() << "-" << ++cgroupCount;
+    if (mkdir(path.str().c_str(), 0755) < 0)
+        return false;
+
+    bool success = true;
+    if (options.memory != RLIM_INFINITY) {
+        stringstream value;
+        value << options.memory;
+        success &= writeCgroupFile(path.str() + "/memory.max", value.str());
+    }
+    if (success && options.cpuQuota) {
+        stringstream value;
+        value << options.cpuQuota * 1000 << " 100000";
+        success &= writeCgroupFile(path.str() + "/cpu.max", value.str());
+    }
+    if (!success) {
+        rmdir(path.str().c_str());
+        return false;
+    }
+    options.cgroup = path.str();
+    return true;
+}
+
+/* Dipanggil di child sebelum exec. Kalau affinity atau prioritas gagal dipasang,
+   child keluar dengan status 1 seperti taskset(1) dan nice(1).  */
+void Shell::applyJobOptions(const JobOptions& options) {
+    bool inCgroup = options.cgroup.size() && writeCgroupFile(options.cgroup + "/cgroup.procs", "0");
+    if (options.hasCpu)
+        setSoftLimit(RLIMIT_CPU, options.cpu);
+    if (options.hasMemory && (!inCgroup || options.memory == RLIM_INFINITY))
+        setSoftLimit(RLIMIT_AS, options.memory);
+    if (options.hasFiles)
+        setSoftLimit(RLIMIT_NOFILE, options.files);
+    if (options.hasCore)
+        setSoftLimit(RLIMIT_CORE, options.core);
+
+    if (options.affinity.size()) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (unsigned int i = 0; i < options.affinity.size(); ++i)
+            CPU_SET(options.affinity[i], &set);
+        if (sched_setaffinity(0, sizeof(set), &set) < 0) {
+            cerr << "taskset: failed to set affinity: " << strerror(errno) << endl;
+            _exit(1);
+        }
+    }
+    if (options.hasNiceness && setpriority(PRIO_PROCESS, 0, options.niceness) < 0) {
+        cerr << "nice: cannot set niceness: " << strerror(errno) << endl;
+        _exit(1);
+    }
+    if (options.ioClass != -1 &&
+        syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0, options.ioClass << IOPRIO_CLASS_SHIFT | options.ioLevel) < 0) {
+        cerr << "ionice: cannot set priority: " << strerror(errno) << endl;
+        _exit(1);
+    }
+}
+
+vector<int> Shell::allowedCpus() const {
+    vector<int> cpus;
+    cpu_set_t set;
+    if (sched_getaffinity(0, sizeof(set), &set) == 0)
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+            if (CPU_ISSET(cpu, &set))
+                cpus.push_back(cpu);
+    return cpus;
+}
+
+bool Shell::findJob(const string& builtin, const string& spec, Job& job) {
+    bool byJobId = spec.size() && spec[0] == '%';
+    stringstream ss(byJobId ? spec.substr(1) : spec);
+    int value = -1;
+    ss >> value;
+    if (byJobId ? jobManager.Get(job, value-1) : jobManager.Get(value, job))
+        return true;
+    if (byJobId)
+        cerr << builtin << ": " << value << ": no such job" << endl;
+    else
+        cerr << builtin << ": " << value << ": no such PID" << endl;
+    return false;
+}
+
+/* Semua thread dari semua process di process group job ikut dipindah.  */
+bool Shell::setJobAffinity(Job& job, const vector<int>& cpus) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (unsigned int i = 0; i < cpus.size(); ++i)
+        CPU_SET(cpus[i], &set);
+
+    DIR* proc = opendir("/proc");
+    if (!proc) {
+        cerr << "taskset: /proc: " << strerror(errno) << endl;
+        return false;
+    }
+    int moved = 0;
+    struct dirent* process;
+    while ((process = readdir(proc))) {
+        pid_t pid = atoi(process->d_name);
+        if (pid <= 0 || (job.pgid ? getpgid(pid) != job.pgid : pid != job.pid))
+            continue;
+        string taskPath = string("/proc/") + process->d_name + "/task";
+        DIR* tasks = opendir(taskPath.c_str());
+        if (!tasks)
+            continue;
+        struct dirent* task;
+        while ((task = readdir(tasks))) {
+            pid_t tid = atoi(task->d_name);
+            if (tid > 0 && sched_setaffinity(tid, sizeof(set), &set) == 0)
+                ++moved;
+        }
+        closedir(tasks);
+    }
+    closedir(proc);
+
+    if (!moved) {
+        cerr << "taskset: " << job.pid << ": " << strerror(errno) << endl;
+        return false;
+    }
+    job.options.affinity = cpus;
+    jobManager.Change(job.pid, job.options);
+    return true;
+}
+
+bool* Shell::shellOption(const string& name) {
+    if (name == "spread")
+        return &optionSpread;
+    if (name == "control")
+        return &optionControl;
+    if (name == "capture")
+        return &optionCapture;
+    return NULL;
+}
+
+void Shell::printShellOptions() {
+    const char* names[] = { "spread", "control", "capture" };
+    for (unsigned int i = 0; i < sizeof(names)/sizeof(names[0]); ++i)
+        cout << names[i] << "\t" << (*shellOption(names[i]) ? "on" : "off") << endl;
+}
+
+/* Deadline job/command. Signal untuk job dikirim lewat Job::Target, untuk command pipeline ke pid saja.  */
+void Shell::addDeadline(pid_t pid, bool job, const JobOptions& options) {
+    if (timerFd == -1) {
+        timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        if (timerFd == -1) {
+            cerr << "timeout: " << strerror(errno) << endl;
+            return;
+        }
+    }
+    Deadline deadline;
+    deadline.job = job;
+    deadline.signal = options.timeoutSignal;
+    deadline.killAfter = options.killAfter;
+    deadline.escalated = false;
+    deadlines[pid] = deadline;
+    timerWheel.Add(pid, monotonicMilliseconds() + options.timeout);
+    armTimer();
+}
+
+void Shell::removeDeadline(pid_t pid) {
+    if (deadlines.erase(pid)) {
+        timerWheel.Remove(pid);
+        armTimer();
+    }
+}
+
+void Shell::armTimer() {
+    if (timerFd == -1)
+        return;
+    struct itimerspec timer;
+    memset(&timer, 0, sizeof(timer));
+    long long next = timerWheel.NextDeadline();
+    if (next >= 0) {
+        // 0 berarti disarm, deadline paling awal tetap harus aktif
+        timer.it_value.tv_sec = next / 1000;
+        timer.it_value.tv_nsec = (next % 1000) * 1000000 + 1;
+    }
+    timerfd_settime(timerFd, TFD_TIMER_ABSTIME, &timer, NULL);
+}
+
+/* Deadline lewat: kirim signal, lalu SIGKILL setelah masa tenggang.  */
+void Shell::handleTimer() {
+    uint64_t expirations;
+    while (read(timerFd, &expirations, sizeof(expirations)) > 0);
+
+    vector<pid_t> expired;
+    long long now = monotonicMilliseconds();
+    timerWheel.Expire(now, expired);
+    for (unsigned int i = 0; i < expired.size(); ++i) {
+        map<pid_t, Deadline>::iterator found = deadlines.find(expired[i]);
+        if (found == deadlines.end())
+            continue;
+        pid_t pid = found->first;
+        Deadline& deadline = found->second;
+
+        // Job yang sudah selesai tidak boleh di-signal, pgid-nya bisa sudah dipakai process lain
+        Job job;
+        if (deadline.job && !jobManager.Get(pid, job)) {
+            deadlines.erase(found);
+            continue;
+        }
+
+        int sig = deadline.escalated ? SIGKILL : deadline.signal;
+        kill(deadline.job ? job.Target() : pid, sig);
+        if (deadline.job && !deadline.escalated) {
+            jobManager.MarkExpired(pid, sig);
+            if (job.status == JobSuspended || job.status == JobWaitingInput)
+                kill(job.Target(), SIGCONT);
+        }
+
+        if (!deadline.escalated && deadline.killAfter && sig != SIGKILL) {
+            deadline.escalated = true;
+            timerWheel.Add(pid, now + deadline.killAfter);
+        }
+        else
+            deadlines.erase(found);
+    }
+    armTimer();
 }
@@ -4,21 +4,40 @@
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <sys/select.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/timerfd.h>
+#include <linux/ioprio.h>
+
+#include <sched.h>
+#include <dirent.h>
+#include <poll.h>
 
 #include <fcntl.h>
 #include <unistd.h>
 #include <errno.h>
 #include <termios.h>
 #include <signal.h>
+#include <limits.h>
 
 #include <iostream>
 #include <sstream>
+#include <algorithm>
 #include <vector>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <cmath>
+
+#include <map>
 
 #include "job.h"
+#include "timer.h"
+#include "record.h"
 
 using namespace std;
 
@@ -35,6 +54,10 @@ private:
     void resetTermios();
     void initTermios();
     string readline();
+    int readChar();
+
+    int childPipe[2];
+    bool serviceEvents(bool, int, vector<struct pollfd>* = NULL);
 
     JobManager jobManager;
 
@@ -44,14 +67,102 @@ private:
     static Shell* instance;
     static void SIGCHLD_HANDLER_STATIC(int);
     void SIGCHLD_HANDLER(int);
+    void watchChildren();
+    void reapJobs();
 
     void putJobForeground(Job&, bool);
     void putJobBackground(Job&, bool);
+    int lastStatus;
+    static int exitCode(int);
+    void giveTerminal(pid_t);
+
     void waitJob(Job&);
-    void killJob(Job&);
+    void deleteJob(Job&);
+    bool killJob(Job&, int = SIGKILL);
+    static int parseSignal(const string&);
+
+    struct Deadline {
+        bool job;   // false untuk command pipeline yang tidak ada di tabel job
+        int signal;
+        long long killAfter;
+        bool escalated;
+    };
+    TimerWheel timerWheel;
+    map<pid_t, Deadline> deadlines;
+    int timerFd;
+    void addDeadline(pid_t, bool, const JobOptions&);
+    void removeDeadline(pid_t);
+    void armTimer();
+    void handleTimer();
+
+    SessionRecorder recorder;
+    long long sessionStart;
+    long long commandStarted;       // setelah isi here-document dibaca
+    vector<string> hereDocumentInput;  // baris here-document yang direkam / diputar ulang
+    bool replaying;
+
+    JobOptions pendingOptions;
+    int cgroupCount;
+    bool isJobOptionPrefix(const string&) const;
+    bool parseCpuList(const string&, const string&, vector<int>&) const;
+    bool parseJobOptions(vector<string>&, JobOptions&);
+    bool setShellLimits(const JobOptions&);
+    void printShellLimits();
+    bool createCgroup(JobOptions&);
+    void applyJobOptions(const JobOptions&);
+
+    bool optionSpread;
+    bool optionCapture;
+    int spreadNext;
+    vector<int> allowedCpus() const;
+    bool findJob(const string&, const string&, Job&);
+    bool setJobAffinity(Job&, const vector<int>&);
+
+    bool* shellOption(const string&);
+    void printShellOptions();
+
+    struct ControlClient {
+        int fd;
+        string input, output;
+        pid_t waitPid;
+        int waitId;
+        bool closing;
+    };
+    bool optionControl;
+    int controlSocket;
+    string controlPath;
+    vector<ControlClient> controlClients;
+    bool openControlSocket();
+    void closeControlSocket();
+    void addControlEvents(vector<struct pollfd>&);
+    void handleControlEvents(const vector<struct pollfd>&, unsigned int);
+    void handleControlRequest(ControlClient&, const string&);
+    bool flushControlClient(ControlClient&);
+    void checkControlWaiters();
+    void closeFinishedClients();
+
+    // Pengganti '$' untuk $(...) di dalam kutip, hasilnya tidak dipecah per whitespace
+    static const char CHAR_QUOTED_SUBSTITUTION = 2;
+    struct Substitution {
+        unsigned int token;
+        size_t start, end;
+        bool quoted;
+        string command, output;
+        size_t length;
+        pid_t pid;
+        int fd;
+    };
+    bool expandSubstitutions(vector<string>&);
+    bool isCapturableBuiltin(const vector<string>&);
+    bool startSubstitution(Substitution&);
+    void becomeSubshell();
+
+    bool readHereDocuments(vector<string>&);
+    bool extractHereDocument(vector<string>&, int&);
+    int openHereDocument(const string&);
 
 public:
-	Shell();
+	Shell(bool = true);
     ~Shell();
 
     vector<string> splitCommand(const string &, const char) const;
@@ -61,6 +172,10 @@ public:
     void executeCommand(vector<string>&);
     void printPrompt();
     void runShell();
+    void executeLine(const string&);
+    int getLastStatus() const;
+    bool startRecording(const string&);
+    int replaySession(const string&, double);
 };
 
 #endif
@@ -0,0 +1,124 @@
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+using namespace std;
+
+/* Benchmark startup shell:
+     time-to-first-exec  dari fork shell sampai command pertama mulai jalan
+     time-to-exit        dari fork shell sampai shell -c true/false selesai
+   Command pertama adalah shellStamp (C, static) di direktori yang sama dengan
+   benchmark ini, yang menulis waktu CLOCK_MONOTONIC ke fd STAMP_FD lalu keluar.
+   Exit status shell dicek persis: true harus 0, false harus 1.
+
+   Pemakaian: shellBench [path shell] [jumlah iterasi]  */
+
+static const int STAMP_FD = 3;
+
+static long long now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static long long runShell(const char* shellPath, const string& command, int stampFd, int expectedStatus) {
+    long long start = now();
+    pid_t pid = fork();
+    if (pid == 0) {
+        if (stampFd != -1 && dup2(stampFd, STAMP_FD) < 0)
+            _exit(127);
+        execl(shellPath, shellPath, "-c", command.c_str(), (char*) NULL);
+        _exit(127);
+    }
+    if (pid < 0) {
+        cerr << "fork: " << strerror(errno) << endl;
+        exit(1);
+    }
+    int status;
+    waitpid(pid, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != expectedStatus) {
+        cerr << shellPath << " -c " << command << ": expected exit status " << expectedStatus << ", got ";
+        if (WIFEXITED(status))
+            cerr << WEXITSTATUS(status) << endl;
+        else
+            cerr << "signal " << WTERMSIG(status) << endl;
+        exit(1);
+    }
+    return now() - start;
+}
+
+static void report(const char* name, vector<long long>& samples) {
+    sort(samples.begin(), samples.end());
+    long long total = 0;
+    for (unsigned int i = 0; i < samples.size(); ++i)
+        total += samples[i];
+    printf("%-18s min %8.1f us  p50 %8.1f us  p99 %8.1f us  mean %8.1f us\n",
+        name,
+        samples[0] / 1e3,
+        samples[samples.size()/2] / 1e3,
+        samples[samples.size()*99/100] / 1e3,
+        total / 1e3 / samples.size());
+}
+
+int main(int argc, char** argv) {
+    const char* shellPath = argc > 1 ? argv[1] : "./shell";
+    int iterations = argc > 2 ? atoi(argv[2]) : 1000;
+    if (iterations <= 0) {
+        cerr << "usage: " << argv[0] << " [shell] [iterations]" << endl;
+        return 1;
+    }
+
+    char self[4096];
+    ssize_t length = readlink("/proc/self/exe", self, sizeof(self)-1);
+    if (length < 0) {
+        cerr << "readlink: " << strerror(errno) << endl;
+        return 1;
+    }
+    self[length] = 0;
+    string stampCommand = string(self);
+    stampCommand.erase(stampCommand.rfind('/')+1);
+    stampCommand += "shellStamp";
+    if (access(stampCommand.c_str(), X_OK) < 0) {
+        cerr << stampCommand << ": " << strerror(errno) << endl;
+        return 1;
+    }
+
+    int stampPipe[2];
+    if (pipe2(stampPipe, O_CLOEXEC) < 0) {
+        cerr << "pipe: " << strerror(errno) << endl;
+        return 1;
+    }
+
+    vector<long long> firstExec, exitTime;
+    for (int i = 0; i < iterations; ++i) {
+        long long start = now();
+        runShell(shellPath, stampCommand, stampPipe[1], 0);
+        long long stamp;
+        if (read(stampPipe[0], &stamp, sizeof(stamp)) != sizeof(stamp)) {
+            cerr << "stamp: no timestamp from first command" << endl;
+            return 1;
+        }
+        firstExec.push_back(stamp - start);
+        // Selang-seling supaya exit status yang salah langsung ketahuan
+        if (i % 2)
+            exitTime.push_back(runShell(shellPath, "false", -1, 1));
+        else
+            exitTime.push_back(runShell(shellPath, "true", -1, 0));
+    }
+
+    printf("%s -c, %d iterations\n", shellPath, iterations);
+    report("time-to-first-exec", firstExec);
+    report("time-to-exit", exitTime);
+    return 0;
+}
@@ -2,9 +2,46 @@
 
 using namespace std;
 
-int main() {
+static int usage() {
+    cerr << "usage: shell [-c command | --record file | --replay file [--speed factor | --fast]]" << endl;
+    return 2;
+}
+
+int main(int argc, char** argv) {
+    // shell -c "command": jalankan satu command lalu keluar, tanpa setup terminal
+    if (argc > 2 && strcmp(argv[1], "-c") == 0) {
+        Shell commandShell(false);
+        commandShell.executeLine(argv[2]);
+        return commandShell.getLastStatus();
+    }
+
+    // shell --replay file: jalankan ulang rekaman sebagai load generator
+    if (argc > 1 && strcmp(argv[1], "--replay") == 0) {
+        if (argc < 3)
+            return usage();
+        double speed = 1;
+        if (argc == 4 && strcmp(argv[3], "--fast") == 0)
+            speed = 0;
+        else if (argc == 5 && strcmp(argv[3], "--speed") == 0) {
+            speed = atof(argv[4]);
+            if (speed <= 0)
+                return usage();
+        }
+        else if (argc != 3)
+            return usage();
+
+        Shell commandShell(false);
+        return commandShell.replaySession(argv[2], speed);
+    }
+
     Shell commandShell;
+    if (argc > 1) {
+        if (argc != 3 || strcmp(argv[1], "--record") != 0)
+            return usage();
+        if (!commandShell.startRecording(argv[2]))
+            return 1;
+    }
     commandShell.runShell();
 
-    return 0;
+    return commandShell.getLastStatus();
 }
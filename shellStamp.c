@@ -0,0 +1,12 @@
+#include <time.h>
+#include <unistd.h>
+
+/* Helper shellBench: tulis waktu CLOCK_MONOTONIC (ns) ke fd 3 lalu keluar.
+   Ditulis dalam C dan di-link static supaya startup-nya sendiri tidak ikut terukur.  */
+int main(void) {
+    struct timespec ts;
+    long long stamp;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    stamp = ts.tv_sec * 1000000000LL + ts.tv_nsec;
+    return write(3, &stamp, sizeof(stamp)) == sizeof(stamp) ? 0 : 1;
+}
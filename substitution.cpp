@@ -0,0 +1,255 @@
+#include "shell.h"
+
+#include <algorithm>
+
+using namespace std;
+
+/* Command substitution $(...).
+   Semua substitusi dalam satu baris dijalankan bersamaan, output-nya dibaca
+   lewat pipe dengan poll sampai semua EOF. Builtin yang hanya menulis ke cout
+   dijalankan langsung di process shell tanpa fork.  */
+
+static const size_t READ_CHUNK = 65536;
+
+static bool isBuiltinName(const string& name) {
+    return name == "exit" || name == "cd" || name == "jobs" || name == "fg" || name == "kill" ||
+           name == "renice" || name == "set" || name == "ulimit" || name == "nice" ||
+           name == "ionice" || name == "taskset" || name == "timeout";
+}
+
+/* Command tanpa pipe, redirect, background, atau builtin bisa langsung di-exec.  */
+static bool isPlainCommand(const vector<string>& vCommand) {
+    if (vCommand.empty() || isBuiltinName(vCommand[0]))
+        return false;
+    for (unsigned int i = 0; i < vCommand.size(); ++i) {
+        const string& token = vCommand[i];
+        if (token == "|" || token == "&" || token == "<" || token == ">" || token.compare(0, 2, "<<") == 0)
+            return false;
+    }
+    return true;
+}
+
+/* Posisi "$(" berikutnya, termasuk yang ditandai parseCommand karena ada di dalam kutip.  */
+static size_t findSubstitution(const string& token, size_t from, char quotedMarker) {
+    for (size_t i = from; i+1 < token.size(); ++i)
+        if ((token[i] == '$' || token[i] == quotedMarker) && token[i+1] == '(')
+            return i;
+    return string::npos;
+}
+
+bool Shell::isCapturableBuiltin(const vector<string>& vCommand) {
+    if (vCommand.empty())
+        return false;
+    if (vCommand[0] == "jobs")
+        return true;
+    if (vCommand[0] == "set")
+        return vCommand.size() == 1 || (vCommand.size() == 2 && vCommand[1] == "-o");
+    return vCommand.size() == 1 && (vCommand[0] == "ulimit" || vCommand[0] == "nice");
+}
+
+bool Shell::expandSubstitutions(vector<string>& vCommand) {
+    vector<Substitution> substitutions;
+    for (unsigned int i = 0; i < vCommand.size(); ++i) {
+        const string& token = vCommand[i];
+        for (size_t start = findSubstitution(token, 0, CHAR_QUOTED_SUBSTITUTION); start != string::npos;
+             start = findSubstitution(token, start, CHAR_QUOTED_SUBSTITUTION)) {
+            int depth = 0;
+            size_t end = start+1;
+            for (; end < token.size(); ++end) {
+                if (token[end] == '(')
+                    ++depth;
+                else if (token[end] == ')' && --depth == 0)
+                    break;
+            }
+            if (end == token.size()) {
+                cerr << "command substitution: syntax error, expected ')'" << endl;
+                return false;
+            }
+
+            Substitution substitution;
+            substitution.token = i;
+            substitution.start = start;
+            substitution.end = end+1;
+            substitution.quoted = token[start] == CHAR_QUOTED_SUBSTITUTION;
+            substitution.command = token.substr(start+2, end-start-2);
+            substitution.length = 0;
+            substitution.pid = -1;
+            substitution.fd = -1;
+            substitutions.push_back(substitution);
+            start = end+1;
+        }
+    }
+    if (substitutions.empty())
+        return true;
+
+    // Mulai semua command eksternal dulu supaya jalan bersamaan
+    bool success = true;
+    for (unsigned int i = 0; success && i < substitutions.size(); ++i)
+        if (!isCapturableBuiltin(parseCommand(substitutions[i].command)))
+            success = startSubstitution(substitutions[i]);
+
+    // Builtin langsung ditangkap dari cout
+    for (unsigned int i = 0; success && i < substitutions.size(); ++i) {
+        Substitution& substitution = substitutions[i];
+        if (substitution.pid != -1)
+            continue;
+        vector<string> vBuiltin = parseCommand(substitution.command);
+        stringstream capture;
+        streambuf* saved = cout.rdbuf(capture.rdbuf());
+        executeCommand(vBuiltin);
+        cout.rdbuf(saved);
+        substitution.output = capture.str();
+        substitution.length = substitution.output.size();
+    }
+
+    // Baca semua pipe sampai EOF, event shell (job, control socket, timeout) tetap dilayani
+    int nOpen = 0;
+    for (unsigned int i = 0; i < substitutions.size(); ++i)
+        nOpen += substitutions[i].fd != -1;
+    while (nOpen) {
+        vector<struct pollfd> fds;
+        vector<unsigned int> owner;
+        for (unsigned int i = 0; i < substitutions.size(); ++i)
+            if (substitutions[i].fd != -1) {
+                struct pollfd fd;
+                fd.fd = substitutions[i].fd;
+                fd.events = POLLIN;
+                fds.push_back(fd);
+                owner.push_back(i);
+            }
+        serviceEvents(false, -1, &fds);
+        for (unsigned int i = 0; i < fds.size(); ++i) {
+            if (!fds[i].revents)
+                continue;
+            Substitution& substitution = substitutions[owner[i]];
+            // Buffer tumbuh dua kali lipat, read langsung ke ujung buffer tanpa copy
+            if (substitution.output.size() - substitution.length < READ_CHUNK)
+                substitution.output.resize(max(substitution.output.size()*2, substitution.length + READ_CHUNK));
+            ssize_t n = read(substitution.fd, &substitution.output[substitution.length],
+                             substitution.output.size() - substitution.length);
+            if (n > 0)
+                substitution.length += n;
+            else if (n == 0 || errno != EINTR) {
+                close(substitution.fd);
+                substitution.fd = -1;
+                --nOpen;
+            }
+        }
+    }
+
+    for (unsigned int i = 0; i < substitutions.size(); ++i) {
+        Substitution& substitution = substitutions[i];
+        if (substitution.fd != -1)
+            close(substitution.fd);
+        if (substitution.pid > 0) {
+            int status;
+            pid_t waited;
+            while ((waited = waitpid(substitution.pid, &status, WNOHANG)) == 0)
+                serviceEvents(false, -1);
+            if (waited > 0)
+                lastStatus = exitCode(status);
+        }
+
+        // Buang newline di akhir dengan memotong panjang, tanpa copy
+        size_t length = substitution.length;
+        while (length && substitution.output[length-1] == '\n')
+            --length;
+        substitution.output.resize(length);
+    }
+    if (!success)
+        return false;
+
+    // Ganti dari belakang supaya posisi substitusi sebelumnya tetap benar
+    for (int i = substitutions.size()-1; i >= 0; --i) {
+        Substitution& substitution = substitutions[i];
+        string& token = vCommand[substitution.token];
+        if (substitution.start == 0 && substitution.end == token.size() && !substitution.quoted) {
+            // Satu token penuh tanpa kutip, hasilnya dipecah per whitespace
+            vector<string> words;
+            stringstream ss(substitution.output);
+            string word;
+            while (ss >> word)
+                words.push_back(word);
+            vCommand.erase(vCommand.begin() + substitution.token);
+            vCommand.insert(vCommand.begin() + substitution.token, words.begin(), words.end());
+        }
+        else
+            token.replace(substitution.start, substitution.end - substitution.start, substitution.output);
+    }
+    return true;
+}
+
+bool Shell::startSubstitution(Substitution& substitution) {
+    int fds[2];
+    if (pipe2(fds, O_CLOEXEC) < 0) {
+        cerr << "command substitution: " << strerror(errno) << endl;
+        return false;
+    }
+
+    watchChildren();
+    cout.flush();
+    pid_t pid = fork();
+    if (pid == 0) {
+        becomeSubshell();
+        /* Set the handling for job control signals back to the default.  */
+        signal (SIGINT, SIG_DFL);
+        signal (SIGQUIT, SIG_DFL);
+        signal (SIGTSTP, SIG_DFL);
+        signal (SIGTTIN, SIG_DFL);
+        signal (SIGTTOU, SIG_DFL);
+        if (dup2(fds[1], STDOUT_FILENO) < 0)
+            exit(EXIT_FAILURE);
+
+        // Substitusi bersarang diekspansi di child ini
+        vector<string> vCommand = parseCommand(substitution.command);
+        if (!expandSubstitutions(vCommand))
+            exit(EXIT_FAILURE);
+
+        if (isPlainCommand(vCommand)) {
+            vector<char*> args;
+            for (unsigned int i = 0; i < vCommand.size(); ++i)
+                args.push_back(const_cast<char*>(vCommand[i].c_str()));
+            args.push_back(NULL);
+            execvp(args[0], &args[0]);
+            cerr << args[0] << ": " << strerror(errno) << endl;
+            exit(127);
+        }
+        executeCommand(vCommand);
+        cout.flush();
+        exit(lastStatus);
+    }
+
+    close(fds[1]);
+    if (pid < 0) {
+        cerr << "fork: failed to create child process" << endl;
+        close(fds[0]);
+        return false;
+    }
+    substitution.pid = pid;
+    substitution.fd = fds[0];
+    return true;
+}
+
+/* Child hasil fork yang masih menjalankan kode shell: jangan sentuh terminal
+   dan jangan ikut melayani fd milik shell induk. Pipe SIGCHLD dibuat baru
+   oleh watchChildren supaya child tidak menguras pipe milik induk.  */
+void Shell::becomeSubshell() {
+    shell_is_interactive = 0;
+    if (childPipe[0] != -1) {
+        close(childPipe[0]);
+        close(childPipe[1]);
+    }
+    childPipe[0] = childPipe[1] = -1;
+    for (unsigned int i = 0; i < controlClients.size(); ++i)
+        close(controlClients[i].fd);
+    controlClients.clear();
+    if (controlSocket != -1)
+        close(controlSocket);
+    controlSocket = -1;
+    jobManager.CloseOutputs();
+    deadlines.clear();
+    timerWheel.Clear();
+    if (timerFd != -1)
+        close(timerFd);
+    timerFd = -1;
+}
@@ -0,0 +1,87 @@
+#include "timer.h"
+
+using namespace std;
+
+TimerWheel::TimerWheel(long long resolution, unsigned int nSlots):
+    slots(nSlots),
+    resolution(resolution),
+    currentTick(-1),
+    nEntries(0) {
+
+}
+
+void TimerWheel::Add(pid_t key, long long deadline) {
+    Remove(key);
+    Entry entry;
+    entry.key = key;
+    entry.tick = (deadline + resolution - 1) / resolution;
+    // Deadline yang sudah lewat bunyi di putaran Expire berikutnya
+    if (currentTick >= 0 && entry.tick <= currentTick)
+        entry.tick = currentTick + 1;
+    slots[entry.tick % slots.size()].push_back(entry);
+    ++nEntries;
+}
+
+bool TimerWheel::Remove(pid_t key) {
+    for (unsigned int i = 0; i < slots.size(); ++i)
+        for (unsigned int j = 0; j < slots[i].size(); ++j)
+            if (slots[i][j].key == key) {
+                slots[i].erase(slots[i].begin() + j);
+                --nEntries;
+                return true;
+            }
+    return false;
+}
+
+/* Deadline terdekat dalam satu putaran wheel. Kalau semua entry ada di putaran
+   berikutnya, return akhir putaran ini supaya wheel dicek ulang. -1 kalau kosong.  */
+long long TimerWheel::NextDeadline() const {
+    if (!nEntries)
+        return -1;
+    long long firstTick = currentTick + 1;
+    if (currentTick < 0) {
+        // Belum pernah Expire, cari tick terkecil langsung
+        long long earliest = -1;
+        for (unsigned int i = 0; i < slots.size(); ++i)
+            for (unsigned int j = 0; j < slots[i].size(); ++j)
+                if (earliest == -1 || slots[i][j].tick < earliest)
+                    earliest = slots[i][j].tick;
+        return earliest * resolution;
+    }
+    for (long long tick = firstTick; tick < firstTick + (long long) slots.size(); ++tick) {
+        const vector<Entry>& slot = slots[tick % slots.size()];
+        for (unsigned int j = 0; j < slot.size(); ++j)
+            if (slot[j].tick <= tick)
+                return tick * resolution;
+    }
+    return (firstTick + slots.size()) * resolution;
+}
+
+void TimerWheel::Expire(long long now, vector<pid_t>& expired) {
+    long long nowTick = now / resolution;
+    long long firstTick = currentTick < 0 ? nowTick - slots.size() + 1 : currentTick + 1;
+    // Lompatan lebih dari satu putaran cukup cek tiap slot sekali
+    if (nowTick - firstTick >= (long long) slots.size())
+        firstTick = nowTick - slots.size() + 1;
+
+    for (long long tick = firstTick; tick <= nowTick; ++tick) {
+        vector<Entry>& slot = slots[tick % slots.size()];
+        for (unsigned int j = 0; j < slot.size(); ) {
+            if (slot[j].tick <= nowTick) {
+                expired.push_back(slot[j].key);
+                slot.erase(slot.begin() + j);
+                --nEntries;
+            }
+            else
+                ++j;
+        }
+    }
+    if (nowTick > currentTick)
+        currentTick = nowTick;
+}
+
+void TimerWheel::Clear() {
+    for (unsigned int i = 0; i < slots.size(); ++i)
+        slots[i].clear();
+    nEntries = 0;
+}
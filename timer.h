@@ -0,0 +1,36 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <vector>
+
+#include <sys/types.h>
+
+using namespace std;
+
+/* Hashed timer wheel. Deadline dalam milidetik CLOCK_MONOTONIC dibulatkan ke
+   atas ke resolusi wheel, key-nya pid. Satu timerfd cukup untuk semua deadline:
+   pasang di NextDeadline(), lalu panggil Expire() waktu timerfd bunyi.  */
+class TimerWheel {
+private:
+    struct Entry {
+        pid_t key;
+        long long tick;
+    };
+    vector<vector<Entry> > slots;
+    long long resolution;
+    long long currentTick;
+    int nEntries;
+
+public:
+    TimerWheel(long long = 10, unsigned int = 512);
+
+    void Add(pid_t, long long);
+    bool Remove(pid_t);
+    long long NextDeadline() const;
+    void Expire(long long, vector<pid_t>&);
+    void Clear();
+
+    bool Empty() const { return nEntries == 0; };
+};
+
+#endif